@@ -0,0 +1,126 @@
+// Reed-Solomon coding throughput, the data of the groups coded into their parity per second and
+// the groups rebuilt per second when as many of their blocks are lost as they have parity blocks
+#include "detail/fec.hpp"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+#include <cstring>
+#include <iostream>
+
+namespace{
+	// each way of coding runs for about this long
+	constexpr auto run_time = std::chrono::milliseconds(300);
+
+	struct group{
+		std::vector<std::vector<std::uint8_t>>	data;
+		std::vector<std::vector<std::uint8_t>>	parity;
+		std::vector<std::uint8_t*>				parity_ptrs;
+
+		group(std::size_t data_count, std::size_t parity_count, std::size_t block_size, std::mt19937& rng)
+			: data(data_count, std::vector<std::uint8_t>(block_size)),
+			parity(parity_count, std::vector<std::uint8_t>(block_size)){
+			auto byte = std::uniform_int_distribution<int>(0, 255);
+			for (auto& block : data){
+				for (auto& b : block)
+					b = static_cast<std::uint8_t>(byte(rng));
+			}
+			for (auto& block : parity)
+				parity_ptrs.push_back(block.data());
+		}
+
+		void encode(const ya_uftp::detail::fec_codec& codec){
+			for (auto& block : parity)
+				std::memset(block.data(), 0, block.size());
+			for (auto i = std::size_t(0u); i < data.size(); i++)
+				codec.encode(i, api::blob_view{ data[i].data(), data[i].size() }, parity_ptrs.data());
+		}
+	};
+
+	template<typename F>
+	double bytes_per_second(std::size_t bytes_per_run, F code){
+		const auto begin = std::chrono::steady_clock::now();
+		auto coded = std::size_t(0u);
+		auto elapsed = std::chrono::duration<double>{};
+		while (elapsed < run_time){
+			code();
+			coded += bytes_per_run;
+			elapsed = std::chrono::steady_clock::now() - begin;
+		}
+		return coded / elapsed.count();
+	}
+}
+
+int main(){
+	auto rng = std::mt19937{ 20240601u };
+	auto mismatches = 0u;
+	struct shape{
+		std::uint8_t	data_count;
+		std::uint8_t	parity_count;
+		std::size_t		block_size;
+	};
+
+	for (auto s : { shape{ 16u, 2u, 1300u }, shape{ 32u, 4u, 1300u }, shape{ 64u, 8u, 1300u },
+		shape{ 128u, 16u, 1300u }, shape{ 32u, 4u, 8192u } }){
+		const auto codec = ya_uftp::detail::fec_codec{ s.data_count, s.parity_count };
+		auto g = group{ s.data_count, s.parity_count, s.block_size, rng };
+		const auto group_bytes = std::size_t(s.data_count) * s.block_size;
+
+		auto encode = bytes_per_second(group_bytes, [&g, &codec](){ g.encode(codec); });
+
+		// the parity count of data blocks are lost, spread over the group
+		auto received = std::vector<bool>(s.data_count, true);
+		for (auto k = 0u; k < s.parity_count; k++)
+			received[k * s.data_count / s.parity_count] = false;
+		auto received_flags = std::unique_ptr<bool[]>(new bool[s.data_count]);
+		std::copy(received.begin(), received.end(), received_flags.get());
+		auto rebuilt = std::vector<std::vector<std::uint8_t>>(g.data);
+		auto rebuilt_ptrs = std::vector<std::uint8_t*>{};
+		for (auto i = std::size_t(0u); i < rebuilt.size(); i++){
+			if (not received[i])
+				std::fill(rebuilt[i].begin(), rebuilt[i].end(), std::uint8_t(0u));
+			rebuilt_ptrs.push_back(rebuilt[i].data());
+		}
+		auto parity = std::vector<std::vector<std::uint8_t>>(g.parity);
+		auto parity_ptrs = std::vector<std::uint8_t*>{};
+		for (auto& block : parity)
+			parity_ptrs.push_back(block.data());
+
+		g.encode(codec);
+		auto decode = bytes_per_second(group_bytes, [&](){
+			// the decoding consumes the parity
+			for (auto k = std::size_t(0u); k < parity.size(); k++)
+				std::memcpy(parity[k].data(), g.parity[k].data(), s.block_size);
+			codec.decode(s.data_count, rebuilt_ptrs.data(), received_flags.get(), parity_ptrs.data(), parity_ptrs.size(), s.block_size);
+		});
+		for (auto i = std::size_t(0u); i < g.data.size(); i++){
+			if (rebuilt[i] != g.data[i])
+				mismatches++;
+		}
+
+		// the rows after the first ones, as the parity repairs send them, rebuild the same blocks alone
+		auto repair_ptrs = std::vector<std::uint8_t*>(codec.max_parity_count(), nullptr);
+		for (auto k = std::size_t(0u); k < parity.size(); k++){
+			std::fill(parity[k].begin(), parity[k].end(), std::uint8_t(0u));
+			repair_ptrs[s.parity_count + k] = parity[k].data();
+		}
+		for (auto i = std::size_t(0u); i < g.data.size(); i++)
+			codec.encode(i, api::blob_view{ g.data[i].data(), g.data[i].size() }, parity_ptrs.data(), s.parity_count, parity.size());
+		for (auto i = std::size_t(0u); i < rebuilt.size(); i++){
+			if (not received[i])
+				std::fill(rebuilt[i].begin(), rebuilt[i].end(), std::uint8_t(0u));
+		}
+		codec.decode(s.data_count, rebuilt_ptrs.data(), received_flags.get(), repair_ptrs.data(), repair_ptrs.size(), s.block_size);
+		for (auto i = std::size_t(0u); i < g.data.size(); i++){
+			if (rebuilt[i] != g.data[i])
+				mismatches++;
+		}
+
+		std::cout << int(s.data_count) << " + " << int(s.parity_count) << " blocks of " << s.block_size << " bytes\n"
+			<< "  encode: " << encode * 8 / 1e9 << " Gbps of data\n"
+			<< "  decode " << int(s.parity_count) << " lost: " << decode * 8 / 1e9 << " Gbps of data" << std::endl;
+	}
+	std::cout << "mismatches: " << mismatches << std::endl;
+	return mismatches == 0u ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+// FILE_SEG headers built per second, the way every block used to be built versus the per task template
+#include "detail/file_transfer_base.hpp"
+#include "boost/endian/conversion.hpp"
+#include <chrono>
+#include <vector>
+#include <iostream>
+
+namespace{
+	constexpr auto block_size = std::uint16_t(1300u);
+	constexpr auto file_size = std::uintmax_t(4u) * 1024u * 1024u * 1024u;
+
+	struct bench_file : ya_uftp::detail::file_transfer_base{
+		std::uint16_t	msg_seq_num = 0u;
+		std::chrono::microseconds	grtt = std::chrono::milliseconds(500);
+
+		bench_file(){
+			on_file_size_learned(file_size, block_size, ya_uftp::message::max_block_count_per_section);
+		}
+
+		void setup_header(ya_uftp::message::protocol_header& uftp_hdr, ya_uftp::message::role r){
+			uftp_hdr.message_role = r;
+			uftp_hdr.sequence_number = boost::endian::native_to_big(msg_seq_num++);
+			uftp_hdr.source_id = 0x01020304u;
+			uftp_hdr.session_id = 0x05060708u;
+			uftp_hdr.group_instance = 0u;
+			uftp_hdr.grtt = ya_uftp::message::quantize_grtt(static_cast<double>(grtt.count()) / 1000000);
+			uftp_hdr.group_size = 0u;
+		}
+
+		void build_per_block(std::uint8_t* buf, std::uintmax_t block_idx){
+			auto uftp_hdr = new (buf) ya_uftp::message::protocol_header;
+			setup_header(*uftp_hdr, ya_uftp::message::role::file_seg);
+			auto fseg_hdr = new (buf + sizeof(ya_uftp::message::protocol_header)) ya_uftp::message::file_seg;
+			fseg_hdr->header_length = sizeof(ya_uftp::message::file_seg) / ya_uftp::message::header_length_unit;
+			fseg_hdr->file_id = 1u;
+			auto [sect_idx, blk_idx] = abs_block_idx_to_sect_blk(block_idx);
+			fseg_hdr->section_idx = sect_idx;
+			fseg_hdr->block_idx = blk_idx;
+			fseg_hdr->make_transfer_ready();
+		}
+
+		ya_uftp::message::header_template<ya_uftp::message::file_seg>	fseg_template;
+		block_cursor	cursor;
+		std::uint64_t	grtt_cache = std::numeric_limits<std::uint64_t>::max();
+
+		std::uint8_t quantized_grtt(){
+			const auto us = static_cast<std::uint64_t>(grtt.count());
+			if ((grtt_cache >> 8) != us)
+				grtt_cache = (us << 8) | ya_uftp::message::quantize_grtt(static_cast<double>(us) / 1000000);
+			return static_cast<std::uint8_t>(grtt_cache);
+		}
+
+		void prepare_template(){
+			new (&fseg_template.uftp_header()) ya_uftp::message::protocol_header;
+			setup_header(fseg_template.uftp_header(), ya_uftp::message::role::file_seg);
+			auto& fseg_hdr = *new (&fseg_template.header()) ya_uftp::message::file_seg;
+			fseg_hdr.header_length = sizeof(ya_uftp::message::file_seg) / ya_uftp::message::header_length_unit;
+			fseg_hdr.file_id = 1u;
+			fseg_hdr.make_transfer_ready();
+		}
+
+		void build_from_template(std::uint8_t* buf, std::uintmax_t block_idx){
+			auto fseg_hdr = fseg_template.stamp(buf, msg_seq_num++, quantized_grtt());
+			auto [sect_idx, blk_idx] = locate_block(cursor, block_idx);
+			fseg_hdr->section_idx = boost::endian::native_to_big(sect_idx);
+			fseg_hdr->block_idx = boost::endian::native_to_big(blk_idx);
+		}
+
+		std::uintmax_t blocks() const{
+			return m_block_count;
+		}
+	};
+
+	template<typename F>
+	double headers_per_second(bench_file& file, std::vector<std::uint8_t>& buf, F build){
+		const auto begin = std::chrono::steady_clock::now();
+		for (auto block_idx = std::uintmax_t(0u); block_idx < file.blocks(); block_idx++)
+			build(buf.data() + (block_idx % 64u) * 64u, block_idx);
+		const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin);
+		return file.blocks() / elapsed.count();
+	}
+}
+
+int main(){
+	auto file = bench_file{};
+	auto buf = std::vector<std::uint8_t>(64u * 64u);
+	auto checksum = 0u;
+
+	auto per_block = headers_per_second(file, buf, [&file](std::uint8_t* p, std::uintmax_t idx){
+		file.build_per_block(p, idx); });
+	for (auto b : buf)
+		checksum += b;
+
+	file.prepare_template();
+	auto templated = headers_per_second(file, buf, [&file](std::uint8_t* p, std::uintmax_t idx){
+		file.build_from_template(p, idx); });
+	for (auto b : buf)
+		checksum += b;
+
+	std::cout << "blocks per run:     " << file.blocks() << '\n'
+		<< "built per block:    " << per_block << " headers/s\n"
+		<< "stamped from template: " << templated << " headers/s\n"
+		<< "speedup:            " << templated / per_block << "x\n"
+		<< "(checksum " << checksum << ")" << std::endl;
+	return 0;
+}
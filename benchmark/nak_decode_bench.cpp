@@ -0,0 +1,93 @@
+// NAK maps of full sections decoded per second, the way they used to be decoded into a std::set versus
+// the word level decoder into an index vector and the merge into the bitmap of a file
+#include "detail/message.hpp"
+#include "detail/block_bitmap.hpp"
+#include <chrono>
+#include <random>
+#include <set>
+#include <vector>
+#include <iostream>
+
+namespace{
+	constexpr auto map_size = std::size_t(ya_uftp::message::max_block_count_per_section / 8u);
+	constexpr auto maps_count = 64u;
+	// each way of decoding runs over the maps for about this long
+	constexpr auto run_time = std::chrono::milliseconds(300);
+
+	std::set<ya_uftp::message::block_index> decode_into_set(const api::blob_view nak_map){
+		auto loss_blocks_ids = std::set<ya_uftp::message::block_index>{};
+		for (auto j = std::size_t(0u); j < nak_map.size(); j++){
+			if (nak_map[j] != 0){
+				for (auto k = 0u; k < 8u; k++){
+					if ((nak_map[j] >> k) & 0x1)
+						loss_blocks_ids.emplace(static_cast<ya_uftp::message::block_index>(j * 8u + k));
+				}
+			}
+		}
+		return loss_blocks_ids;
+	}
+
+	std::vector<std::vector<std::uint8_t>> make_maps(double loss, std::mt19937& rng){
+		auto maps = std::vector<std::vector<std::uint8_t>>(maps_count, std::vector<std::uint8_t>(map_size, 0u));
+		auto lost = std::bernoulli_distribution(loss);
+		for (auto& map : maps){
+			for (auto bit = std::size_t(0u); bit < map_size * 8u; bit++){
+				if (lost(rng))
+					map[bit / 8u] |= static_cast<std::uint8_t>(1u << (bit % 8u));
+			}
+		}
+		return maps;
+	}
+
+	template<typename F>
+	double maps_per_second(const std::vector<std::vector<std::uint8_t>>& maps, F decode){
+		const auto begin = std::chrono::steady_clock::now();
+		auto decoded = std::size_t(0u);
+		auto elapsed = std::chrono::duration<double>{};
+		while (elapsed < run_time){
+			for (auto& map : maps)
+				decode(api::blob_view{ map.data(), map.size() });
+			decoded += maps.size();
+			elapsed = std::chrono::steady_clock::now() - begin;
+		}
+		return decoded / elapsed.count();
+	}
+}
+
+int main(){
+	auto rng = std::mt19937{ 20240501u };
+	auto checksum = std::uint64_t(0u);
+	auto mismatches = 0u;
+	auto lost = std::vector<ya_uftp::message::block_index>{};
+	auto file_map = ya_uftp::detail::block_bitmap{};
+	file_map.assign(std::uintmax_t(map_size) * 8u * maps_count, false);
+
+	std::cout << "section of " << map_size * 8u << " blocks, " << maps_count << " maps per round" << std::endl;
+	for (auto loss : { 0.0001, 0.01, 0.1, 0.5, 1.0 }){
+		auto maps = make_maps(loss, rng);
+		for (auto& map : maps){
+			lost.clear();
+			ya_uftp::message::extract_lost_blocks_ids(api::blob_view{ map.data(), map.size() }, lost);
+			auto reference = decode_into_set(api::blob_view{ map.data(), map.size() });
+			if (not std::equal(reference.begin(), reference.end(), lost.begin(), lost.end()))
+				mismatches++;
+		}
+
+		auto into_set = maps_per_second(maps, [&checksum](api::blob_view map){
+			checksum += decode_into_set(map).size(); });
+		auto into_vector = maps_per_second(maps, [&checksum, &lost](api::blob_view map){
+			lost.clear();
+			checksum += ya_uftp::message::extract_lost_blocks_ids(map, lost); });
+		auto section = 0u;
+		auto into_bitmap = maps_per_second(maps, [&checksum, &file_map, &section](api::blob_view map){
+			checksum += ya_uftp::message::merge_lost_blocks(map, map.size() * 8u, file_map,
+				std::uintmax_t(map.size()) * 8u * (section++ % maps_count)); });
+
+		std::cout << "loss " << loss * 100 << "%\n"
+			<< "  into std::set:     " << into_set << " maps/s\n"
+			<< "  into index vector: " << into_vector << " maps/s (" << into_vector / into_set << "x)\n"
+			<< "  into file bitmap:  " << into_bitmap << " maps/s (" << into_bitmap / into_set << "x)" << std::endl;
+	}
+	std::cout << "mismatches: " << mismatches << "\n(checksum " << checksum << ")" << std::endl;
+	return mismatches == 0u ? 0 : 1;
+}
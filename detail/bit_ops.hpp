@@ -0,0 +1,43 @@
+#pragma once
+#ifndef YA_UFTP_DETAIL_BIT_OPS_HPP_
+#define YA_UFTP_DETAIL_BIT_OPS_HPP_
+
+#include <cstdint>
+#if defined(_MSC_VER) and not defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace ya_uftp{
+	namespace detail{
+		// the index of the lowest set bit, bits must not be 0
+		inline unsigned count_trailing_zeros(std::uint64_t bits){
+#if defined(__GNUC__) or defined(__clang__)
+			return static_cast<unsigned>(__builtin_ctzll(bits));
+#elif defined(_MSC_VER) and (defined(_M_X64) or defined(_M_ARM64))
+			unsigned long idx = 0;
+			_BitScanForward64(&idx, bits);
+			return static_cast<unsigned>(idx);
+#else
+			auto count = 0u;
+			for (; (bits & 1u) == 0u; bits >>= 1)
+				count++;
+			return count;
+#endif
+		}
+
+		inline unsigned popcount(std::uint64_t bits){
+#if defined(__GNUC__) or defined(__clang__)
+			return static_cast<unsigned>(__builtin_popcountll(bits));
+#elif defined(_MSC_VER) and defined(_M_X64)
+			return static_cast<unsigned>(__popcnt64(bits));
+#else
+			auto count = 0u;
+			for (; bits != 0u; bits &= bits - 1)
+				count++;
+			return count;
+#endif
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,134 @@
+#pragma once
+#ifndef YA_UFTP_DETAIL_BLOCK_BITMAP_HPP_
+#define YA_UFTP_DETAIL_BLOCK_BITMAP_HPP_
+
+#include "detail/packet_pool.hpp"
+#include "detail/bit_ops.hpp"
+#include "boost/endian/conversion.hpp"
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+namespace ya_uftp{
+	namespace detail{
+		// one bit per block of the whole file, in 64 bit words laid on cache lines.
+		// the bits past the last block are always clear, so the word level scans need no masking at the end
+		class block_bitmap{
+			using word = std::uint64_t;
+			static constexpr std::size_t	word_bits = 64u;
+			struct alignas(cache_line_size) line{
+				std::array<word, cache_line_size / sizeof(word)>	words;
+			};
+			std::vector<line>	m_lines;
+			std::uintmax_t		m_size = 0u;
+
+			word* words(){
+				return m_lines.empty() ? nullptr : m_lines.front().words.data();
+			}
+			const word* words() const{
+				return m_lines.empty() ? nullptr : m_lines.front().words.data();
+			}
+			std::size_t words_count() const{
+				return static_cast<std::size_t>((m_size + word_bits - 1) / word_bits);
+			}
+			// the 64 bits starting at the bit from, those past the end are clear
+			word load(std::uintmax_t from) const{
+				const auto idx = static_cast<std::size_t>(from / word_bits);
+				const auto shift = from % word_bits;
+				auto bits = words()[idx] >> shift;
+				if (shift > 0u and idx + 1 < words_count())
+					bits |= words()[idx + 1] << (word_bits - shift);
+				return bits;
+			}
+		public:
+			// all the bits take value
+			void assign(std::uintmax_t size, bool value){
+				m_size = size;
+				const auto per_line = cache_line_size * 8u;
+				m_lines.assign(static_cast<std::size_t>((size + per_line - 1) / per_line), line{});
+				if (not value or size == 0u)
+					return;
+				std::memset(words(), 0xff, words_count() * sizeof(word));
+				if (auto tail = size % word_bits; tail > 0u)
+					words()[words_count() - 1] = (word(1) << tail) - 1;
+			}
+			std::uintmax_t size() const{
+				return m_size;
+			}
+			// all the bits clear, the storage is kept
+			void clear(){
+				if (not m_lines.empty())
+					std::memset(words(), 0, words_count() * sizeof(word));
+			}
+			bool none() const{
+				return find_next(0u, m_size) == m_size;
+			}
+			bool test(std::uintmax_t idx) const{
+				return (words()[idx / word_bits] >> (idx % word_bits)) & 1u;
+			}
+			void set(std::uintmax_t idx){
+				words()[idx / word_bits] |= word(1) << (idx % word_bits);
+			}
+			void reset(std::uintmax_t idx){
+				words()[idx / word_bits] &= ~(word(1) << (idx % word_bits));
+			}
+			// the first set bit in [from, to), to if none
+			std::uintmax_t find_next(std::uintmax_t from, std::uintmax_t to) const{
+				while (from < to){
+					const auto idx = static_cast<std::size_t>(from / word_bits);
+					const auto bits = words()[idx] >> (from % word_bits);
+					if (bits != 0u){
+						const auto found = from + static_cast<std::uintmax_t>(count_trailing_zeros(bits));
+						return found < to ? found : to;
+					}
+					from = (static_cast<std::uintmax_t>(idx) + 1) * word_bits;
+				}
+				return to;
+			}
+			// the bits [from, from + count) as bytes, bit k of byte j is the bit from + 8 * j + k.
+			// return the bytes written, which is count rounded up to whole bytes
+			std::size_t extract(std::uintmax_t from, std::uintmax_t count, std::uint8_t* dest) const{
+				const auto bytes = static_cast<std::size_t>((count + 7u) / 8u);
+				for (auto done = std::size_t(0u); done < bytes; done += sizeof(word)){
+					const auto offset = from + static_cast<std::uintmax_t>(done) * 8u;
+					auto bits = load(offset);
+					if (auto left = count - static_cast<std::uintmax_t>(done) * 8u; left < word_bits)
+						bits &= (word(1) << left) - 1;
+					boost::endian::native_to_little_inplace(bits);
+					std::memcpy(dest + done, &bits, std::min(sizeof(word), bytes - done));
+				}
+				return bytes;
+			}
+			// the inverse of extract(), or the bits of the bytes into [from, from + count), those past the end are ignored.
+			// return the count of the bits the bytes have set
+			std::size_t merge(std::uintmax_t from, std::uintmax_t count, const std::uint8_t* src){
+				if (from >= m_size)
+					return 0u;
+				count = std::min(count, m_size - from);
+				const auto bytes = static_cast<std::size_t>((count + 7u) / 8u);
+				auto merged = std::size_t(0u);
+				for (auto done = std::size_t(0u); done < bytes; done += sizeof(word)){
+					auto bits = word(0u);
+					std::memcpy(&bits, src + done, std::min(sizeof(word), bytes - done));
+					boost::endian::little_to_native_inplace(bits);
+					if (auto left = count - static_cast<std::uintmax_t>(done) * 8u; left < word_bits)
+						bits &= (word(1) << left) - 1;
+					if (bits == 0u)
+						continue;
+					merged += static_cast<std::size_t>(popcount(bits));
+					const auto offset = from + static_cast<std::uintmax_t>(done) * 8u;
+					const auto idx = static_cast<std::size_t>(offset / word_bits);
+					const auto shift = offset % word_bits;
+					words()[idx] |= bits << shift;
+					if (shift > 0u and idx + 1 < words_count())
+						words()[idx + 1] |= bits >> (word_bits - shift);
+				}
+				return merged;
+			}
+		};
+	}
+}
+
+#endif
@@ -5,7 +5,9 @@
 #include <memory>
 #include <vector>
 #include <set>
+#include <type_traits>
 #include <iostream>
+#include "detail/packet_pool.hpp"
 
 #ifdef _WIN32
 template<typename PATH>
@@ -46,12 +48,34 @@ namespace ya_uftp{
 		using uint = std::uint64_t;
 	};
 	
-	using message_blob = std::shared_ptr<std::vector<std::uint8_t>>;
+	// non-owning reference to a callable, for callbacks which are invoked before the callee returns.
+	// unlike std::function it never allocates, the referenced callable must outlive the call
+	template<typename Signature>
+	class function_ref;
 	
-	template<typename... Args>
-	inline auto make_message_blob(Args&&... args) -> decltype(std::make_shared<std::vector<std::uint8_t>>(std::forward<Args>(args)...)){
-		return std::make_shared<std::vector<std::uint8_t>>(std::forward<Args>(args)...);
-	}
+	template<typename R, typename... Args>
+	class function_ref<R (Args...)>{
+		void*	m_callable = nullptr;
+		R (*m_invoker)(void*, Args...) = nullptr;
+	public:
+		function_ref() noexcept = default;
+		function_ref(std::nullptr_t) noexcept{}
+		template<typename F, typename = std::enable_if_t<
+			not std::is_same_v<std::decay_t<F>, function_ref> and 
+			std::is_invocable_r_v<R, F&, Args...>>>
+		function_ref(F&& f) noexcept : 
+			m_callable(const_cast<void*>(static_cast<const void*>(std::addressof(f)))),
+			m_invoker([](void* callable, Args... args) -> R {
+				return (*static_cast<std::remove_reference_t<F>*>(callable))(std::forward<Args>(args)...);
+			}){}
+		
+		R operator()(Args... args) const{
+			return m_invoker(m_callable, std::forward<Args>(args)...);
+		}
+		explicit operator bool() const noexcept{
+			return m_invoker != nullptr;
+		}
+	};
 	
 	template<typename K>
 	void merge_2nd_set(std::set<K>& first, const std::set<K>& second){
@@ -0,0 +1,206 @@
+#include "detail/fec.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <vector>
+#if defined(__x86_64__) or defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace ya_uftp{
+	namespace detail{
+		namespace{
+			// x^8 + x^4 + x^3 + x^2 + 1, generated by 2
+			constexpr unsigned gf_polynomial = 0x11du;
+
+			struct gf_tables{
+				std::array<std::uint8_t, 512>	exp = {};
+				std::array<std::uint8_t, 256>	log = {};
+				// the products of each factor by the low nibbles then by the high nibbles,
+				// what a byte shuffle looks up 16 bytes at a time
+				alignas(32) std::uint8_t		nibbles[256][32] = {};
+
+				gf_tables(){
+					auto x = 1u;
+					for (auto i = 0u; i < 255u; i++){
+						exp[i] = exp[i + 255u] = static_cast<std::uint8_t>(x);
+						log[x] = static_cast<std::uint8_t>(i);
+						x <<= 1;
+						if (x & 0x100u)
+							x ^= gf_polynomial;
+					}
+					for (auto factor = 0u; factor < 256u; factor++){
+						for (auto n = 0u; n < 16u; n++){
+							nibbles[factor][n] = mul(static_cast<std::uint8_t>(factor), static_cast<std::uint8_t>(n));
+							nibbles[factor][16u + n] = mul(static_cast<std::uint8_t>(factor), static_cast<std::uint8_t>(n << 4));
+						}
+					}
+				}
+				std::uint8_t mul(std::uint8_t a, std::uint8_t b) const{
+					if (a == 0u or b == 0u)
+						return 0u;
+					return exp[log[a] + log[b]];
+				}
+				std::uint8_t inv(std::uint8_t a) const{
+					assert(a != 0u);
+					return exp[255u - log[a]];
+				}
+			};
+
+			const gf_tables& tables(){
+				static const auto instance = gf_tables{};
+				return instance;
+			}
+
+			void mul_add_scalar(const std::uint8_t* table, const std::uint8_t* src, std::uint8_t* dst, std::size_t length){
+				for (auto i = std::size_t(0u); i < length; i++)
+					dst[i] ^= table[src[i] & 0x0fu] ^ table[16u + (src[i] >> 4)];
+			}
+
+#if (defined(__x86_64__) or defined(__i386__)) and (defined(__GNUC__) or defined(__clang__))
+#define YA_UFTP_HAS_AVX2_FEC 1
+			__attribute__((target("avx2")))
+			void mul_add_avx2(const std::uint8_t* table, const std::uint8_t* src, std::uint8_t* dst, std::size_t length){
+				const auto low_products = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(table)));
+				const auto high_products = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(table + 16)));
+				const auto nibble = _mm256_set1_epi8(0x0f);
+				auto i = std::size_t(0u);
+				for (; i + 2 * sizeof(__m256i) <= length; i += 2 * sizeof(__m256i)){
+					const auto s0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+					const auto s1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + sizeof(__m256i)));
+					const auto p0 = _mm256_xor_si256(
+						_mm256_shuffle_epi8(low_products, _mm256_and_si256(s0, nibble)),
+						_mm256_shuffle_epi8(high_products, _mm256_and_si256(_mm256_srli_epi64(s0, 4), nibble)));
+					const auto p1 = _mm256_xor_si256(
+						_mm256_shuffle_epi8(low_products, _mm256_and_si256(s1, nibble)),
+						_mm256_shuffle_epi8(high_products, _mm256_and_si256(_mm256_srli_epi64(s1, 4), nibble)));
+					auto d0 = reinterpret_cast<__m256i*>(dst + i);
+					auto d1 = reinterpret_cast<__m256i*>(dst + i + sizeof(__m256i));
+					_mm256_storeu_si256(d0, _mm256_xor_si256(_mm256_loadu_si256(d0), p0));
+					_mm256_storeu_si256(d1, _mm256_xor_si256(_mm256_loadu_si256(d1), p1));
+				}
+				for (; i + sizeof(__m256i) <= length; i += sizeof(__m256i)){
+					const auto s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+					const auto p = _mm256_xor_si256(
+						_mm256_shuffle_epi8(low_products, _mm256_and_si256(s, nibble)),
+						_mm256_shuffle_epi8(high_products, _mm256_and_si256(_mm256_srli_epi64(s, 4), nibble)));
+					auto d = reinterpret_cast<__m256i*>(dst + i);
+					_mm256_storeu_si256(d, _mm256_xor_si256(_mm256_loadu_si256(d), p));
+				}
+				mul_add_scalar(table, src + i, dst + i, length - i);
+			}
+
+			bool avx2_supported(){
+				static const auto supported = __builtin_cpu_supports("avx2");
+				return supported;
+			}
+#endif
+		}
+
+		void gf_mul_add(std::uint8_t factor, const std::uint8_t* src, std::uint8_t* dst, std::size_t length){
+			if (factor == 0u)
+				return;
+			const auto table = tables().nibbles[factor];
+#ifdef YA_UFTP_HAS_AVX2_FEC
+			if (avx2_supported()){
+				mul_add_avx2(table, src, dst, length);
+				return;
+			}
+#endif
+			mul_add_scalar(table, src, dst, length);
+		}
+
+		fec_codec::fec_codec(std::uint8_t data_count, std::uint8_t parity_count)
+			: m_data_count(data_count), m_parity_count(parity_count){
+			assert(valid(data_count, parity_count));
+		}
+
+		std::uint8_t fec_codec::coefficient(std::size_t parity_idx, std::size_t data_idx) const{
+			// 1 / (x + y) with x the parity row and y the data index counted from the top of the field,
+			// never zero as the rows stay under the data
+			assert(parity_idx < max_parity_count() and data_idx < m_data_count);
+			return tables().inv(static_cast<std::uint8_t>(parity_idx ^ (max_parity_count() + data_idx)));
+		}
+
+		void fec_codec::encode(std::size_t data_idx, api::blob_view block, std::uint8_t* const* parity) const{
+			encode(data_idx, block, parity, 0u, m_parity_count);
+		}
+
+		void fec_codec::encode(std::size_t data_idx, api::blob_view block, std::uint8_t* const* parity, 
+			std::size_t first_row, std::size_t rows) const{
+			for (auto p = std::size_t(0u); p < rows; p++)
+				gf_mul_add(coefficient(first_row + p, data_idx), block.data(), parity[p], block.size());
+		}
+
+		bool fec_codec::decode(std::size_t group_size, std::uint8_t* const* data, const bool* data_received,
+			std::uint8_t* const* parity, std::size_t parity_rows, std::size_t length) const{
+			auto missing = std::vector<std::size_t>{};
+			for (auto i = std::size_t(0u); i < group_size; i++){
+				if (not data_received[i])
+					missing.push_back(i);
+			}
+			if (missing.empty())
+				return true;
+			auto rows = std::vector<std::size_t>{};
+			for (auto p = std::size_t(0u); p < parity_rows and rows.size() < missing.size(); p++){
+				if (parity[p])
+					rows.push_back(p);
+			}
+			if (rows.size() < missing.size())
+				return false;
+
+			// take the data received out of the parity, what is left codes the missing blocks only
+			for (auto row : rows){
+				for (auto i = std::size_t(0u); i < group_size; i++){
+					if (data_received[i])
+						gf_mul_add(coefficient(row, i), data[i], parity[row], length);
+				}
+			}
+
+			// invert the square of the coefficients of the missing blocks in the rows, Gauss-Jordan on [a | inverse].
+			// any square cut of a Cauchy matrix is invertible, so a pivot is always found
+			auto& gf = tables();
+			const auto n = missing.size();
+			auto a = std::vector<std::uint8_t>(n * n);
+			auto inverse = std::vector<std::uint8_t>(n * n, 0u);
+			for (auto r = std::size_t(0u); r < n; r++){
+				for (auto c = std::size_t(0u); c < n; c++)
+					a[r * n + c] = coefficient(rows[r], missing[c]);
+				inverse[r * n + r] = 1u;
+			}
+			for (auto c = std::size_t(0u); c < n; c++){
+				auto pivot = c;
+				while (a[pivot * n + c] == 0u)
+					pivot++;
+				if (pivot != c){
+					std::swap_ranges(a.begin() + pivot * n, a.begin() + (pivot + 1) * n, a.begin() + c * n);
+					std::swap_ranges(inverse.begin() + pivot * n, inverse.begin() + (pivot + 1) * n, inverse.begin() + c * n);
+				}
+				const auto scale = gf.inv(a[c * n + c]);
+				for (auto k = std::size_t(0u); k < n; k++){
+					a[c * n + k] = gf.mul(a[c * n + k], scale);
+					inverse[c * n + k] = gf.mul(inverse[c * n + k], scale);
+				}
+				for (auto r = std::size_t(0u); r < n; r++){
+					if (r == c or a[r * n + c] == 0u)
+						continue;
+					const auto factor = a[r * n + c];
+					for (auto k = std::size_t(0u); k < n; k++){
+						a[r * n + k] ^= gf.mul(factor, a[c * n + k]);
+						inverse[r * n + k] ^= gf.mul(factor, inverse[c * n + k]);
+					}
+				}
+			}
+
+			for (auto m = std::size_t(0u); m < n; m++){
+				auto dest = data[missing[m]];
+				std::memset(dest, 0, length);
+				for (auto r = std::size_t(0u); r < n; r++)
+					gf_mul_add(inverse[m * n + r], parity[rows[r]], dest, length);
+			}
+			return true;
+		}
+	}
+}
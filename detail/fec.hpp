@@ -0,0 +1,57 @@
+#pragma once
+#ifndef YA_UFTP_DETAIL_FEC_HPP_
+#define YA_UFTP_DETAIL_FEC_HPP_
+
+#include "api_binder.hpp"
+#include <cstdint>
+#include <cstddef>
+
+namespace ya_uftp{
+	namespace detail{
+		// dst ^= factor * src byte by byte over GF(2^8)
+		void gf_mul_add(std::uint8_t factor, const std::uint8_t* src, std::uint8_t* dst, std::size_t length);
+
+		// a systematic Reed-Solomon code over GF(2^8) by a Cauchy matrix. each group of up to data_count blocks
+		// gets parity_count parity blocks, any data_count blocks of the group and its parity rebuild the group.
+		// rows past parity_count, up to max_parity_count, are further parity blocks coded the same way.
+		// a group shorter than data_count is coded as if the blocks past its end were zero, so is a short block
+		class fec_codec{
+			std::uint8_t	m_data_count;
+			std::uint8_t	m_parity_count;
+		public:
+			// the data and the parity blocks of a group at most
+			static constexpr std::size_t	max_symbols = 256u;
+
+			// data_count + parity_count must not be more than max_symbols
+			fec_codec(std::uint8_t data_count, std::uint8_t parity_count);
+			std::uint8_t data_count() const{
+				return m_data_count;
+			}
+			std::uint8_t parity_count() const{
+				return m_parity_count;
+			}
+			// the parity rows a group can have at all
+			std::size_t max_parity_count() const{
+				return max_symbols - m_data_count;
+			}
+			static bool valid(std::size_t data_count, std::size_t parity_count){
+				return data_count > 0u and parity_count > 0u and data_count + parity_count <= max_symbols;
+			}
+			// the factor of the data block data_idx in the parity block parity_idx
+			std::uint8_t coefficient(std::size_t parity_idx, std::size_t data_idx) const;
+			// add the data block data_idx of a group into each of its parity blocks, which start zeroed
+			// and are at least as long as the block
+			void encode(std::size_t data_idx, api::blob_view block, std::uint8_t* const* parity) const;
+			// the same into the parity rows from first_row on, parity holds one block per row
+			void encode(std::size_t data_idx, api::blob_view block, std::uint8_t* const* parity, 
+				std::size_t first_row, std::size_t rows) const;
+			// rebuild the data blocks not received of a group of group_size blocks, all length bytes long.
+			// parity holds a block per row up to parity_rows, nullptr for those not received. those received are consumed.
+			// return false and leave the data untouched when too few blocks are received
+			bool decode(std::size_t group_size, std::uint8_t* const* data, const bool* data_received,
+				std::uint8_t* const* parity, std::size_t parity_rows, std::size_t length) const;
+		};
+	}
+}
+
+#endif
@@ -51,6 +51,22 @@ namespace ya_uftp{
 			else
 				return m_per_big_section_block_count;
 		}
+		
+		std::pair<message::section_index, message::block_index> 
+			file_transfer_base::locate_block(block_cursor& cursor, std::uintmax_t block_idx){
+			if (block_idx != cursor.next_block){
+				auto [sect_idx, blk_idx] = abs_block_idx_to_sect_blk(block_idx);
+				cursor.section_idx = sect_idx;
+				cursor.block_idx = blk_idx;
+			}
+			auto location = std::pair{cursor.section_idx, cursor.block_idx};
+			cursor.next_block = block_idx + 1;
+			if (++cursor.block_idx == section_block_count(cursor.section_idx)){
+				cursor.section_idx++;
+				cursor.block_idx = 0u;
+			}
+			return location;
+		}
 	}
 }
 
@@ -15,6 +15,13 @@ namespace ya_uftp{
 			message::block_index							m_per_big_section_block_count = 0u;
 			message::section_index							m_big_section_count = 0u;
 			
+			// remember where the last block located, so walking the blocks in order costs no division
+			struct block_cursor{
+				std::uintmax_t			next_block = 0u;
+				message::section_index	section_idx = 0u;
+				message::block_index	block_idx = 0u;
+			};
+			
 			file_transfer_base();
 			void on_file_size_learned(const std::uintmax_t file_size, 
 				const std::uint16_t block_size, const std::uint16_t max_block_count_per_section);
@@ -22,6 +29,8 @@ namespace ya_uftp{
 			[[nodiscard]] std::pair<message::section_index, message::block_index> abs_block_idx_to_sect_blk(std::uintmax_t block_idx);
 			[[nodiscard]] std::uintmax_t sect_blk_to_abs_block_idx(message::section_index sect_idx, message::block_index block_idx);
 			message::block_index section_block_count(message::section_index sect_idx);
+			// same as abs_block_idx_to_sect_blk, but only divides when the block is not the one next to the last
+			[[nodiscard]] std::pair<message::section_index, message::block_index> locate_block(block_cursor& cursor, std::uintmax_t block_idx);
 		};
 	}
 }
@@ -0,0 +1,94 @@
+#pragma once
+#ifndef YA_UFTP_DETAIL_HANDLER_MEMORY_HPP_
+#define YA_UFTP_DETAIL_HANDLER_MEMORY_HPP_
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ya_uftp{
+	namespace detail{
+		// one recycled block for a handler which is queued over and over again(but once at a time),
+		// fallback to the heap when the block is taken or too small
+		class handler_memory{
+			static constexpr std::size_t	m_block_size = 256u;
+			std::aligned_storage_t<m_block_size>	m_storage;
+			std::atomic<bool>				m_in_use = false;
+		public:
+			handler_memory() = default;
+			handler_memory(const handler_memory&) = delete;
+			handler_memory& operator=(const handler_memory&) = delete;
+			
+			void* allocate(std::size_t size){
+				if (size <= m_block_size and not m_in_use.exchange(true, std::memory_order_acquire))
+					return &m_storage;
+				return ::operator new(size);
+			}
+			
+			void deallocate(void* p){
+				if (p == &m_storage)
+					m_in_use.store(false, std::memory_order_release);
+				else
+					::operator delete(p);
+			}
+		};
+		
+		// the allocator associated with a handler(through get_allocator()), so asio takes the operation memory
+		// from the handler_memory. it shares the memory since the operation may be destroyed after the object
+		// which queued it
+		template<typename T>
+		class handler_allocator{
+			template<typename> friend class handler_allocator;
+			std::shared_ptr<handler_memory>	m_memory;
+		public:
+			using value_type = T;
+			
+			explicit handler_allocator(std::shared_ptr<handler_memory> memory) noexcept : m_memory(std::move(memory)){}
+			template<typename U>
+			handler_allocator(const handler_allocator<U>& other) noexcept : m_memory(other.m_memory){}
+			
+			T* allocate(std::size_t n) const{
+				return static_cast<T*>(m_memory->allocate(sizeof(T) * n));
+			}
+			void deallocate(T* p, std::size_t) const{
+				m_memory->deallocate(p);
+			}
+			template<typename U>
+			bool operator==(const handler_allocator<U>& other) const noexcept{
+				return m_memory == other.m_memory;
+			}
+			template<typename U>
+			bool operator!=(const handler_allocator<U>& other) const noexcept{
+				return m_memory != other.m_memory;
+			}
+		};
+		
+		template<typename Handler>
+		class handler_with_memory{
+			handler_allocator<Handler>	m_allocator;
+			Handler						m_handler;
+		public:
+			using allocator_type = handler_allocator<Handler>;
+			
+			handler_with_memory(std::shared_ptr<handler_memory> memory, Handler h) : 
+				m_allocator(std::move(memory)), m_handler(std::move(h)){}
+			allocator_type get_allocator() const noexcept{
+				return m_allocator;
+			}
+			template<typename... Args>
+			void operator()(Args&&... args){
+				m_handler(std::forward<Args>(args)...);
+			}
+		};
+		
+		template<typename Handler>
+		inline handler_with_memory<std::decay_t<Handler>> make_handler_with_memory(std::shared_ptr<handler_memory> memory, Handler&& h){
+			return handler_with_memory<std::decay_t<Handler>>{std::move(memory), std::forward<Handler>(h)};
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,132 @@
+#include "detail/io_ring.hpp"
+
+#ifdef YA_UFTP_HAS_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <algorithm>
+
+namespace ya_uftp{
+	namespace detail{
+		namespace{
+			int sys_io_uring_setup(unsigned entries, ::io_uring_params* params){
+				return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+			}
+			
+			int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags){
+				return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+			}
+			
+			int sys_io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args){
+				return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+			}
+		}
+		
+		io_ring::io_ring(private_ctor_tag tag){}
+		
+		io_ring::~io_ring(){
+			if (m_sqes)
+				::munmap(m_sqes, m_sqes_size);
+			if (m_cq_ring and m_cq_ring != m_sq_ring)
+				::munmap(m_cq_ring, m_cq_ring_size);
+			if (m_sq_ring)
+				::munmap(m_sq_ring, m_sq_ring_size);
+			if (m_fd >= 0)
+				::close(m_fd);
+		}
+		
+		std::unique_ptr<io_ring> io_ring::create(unsigned entries){
+			auto params = ::io_uring_params{};
+			auto fd = sys_io_uring_setup(entries, &params);
+			if (fd < 0)
+				return nullptr;
+			
+			auto ring = std::make_unique<io_ring>(private_ctor_tag{});
+			ring->m_fd = fd;
+			ring->m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			ring->m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+			const auto single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+			if (single_mmap)
+				ring->m_sq_ring_size = ring->m_cq_ring_size = std::max(ring->m_sq_ring_size, ring->m_cq_ring_size);
+			
+			auto sq_ring = ::mmap(nullptr, ring->m_sq_ring_size, PROT_READ | PROT_WRITE, 
+				MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+			if (sq_ring == MAP_FAILED)
+				return nullptr;
+			ring->m_sq_ring = sq_ring;
+			if (single_mmap)
+				ring->m_cq_ring = sq_ring;
+			else{
+				auto cq_ring = ::mmap(nullptr, ring->m_cq_ring_size, PROT_READ | PROT_WRITE, 
+					MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+				if (cq_ring == MAP_FAILED)
+					return nullptr;
+				ring->m_cq_ring = cq_ring;
+			}
+			ring->m_sqes_size = params.sq_entries * sizeof(::io_uring_sqe);
+			auto sqes = ::mmap(nullptr, ring->m_sqes_size, PROT_READ | PROT_WRITE, 
+				MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+			if (sqes == MAP_FAILED)
+				return nullptr;
+			ring->m_sqes = static_cast<::io_uring_sqe*>(sqes);
+			
+			auto sq_base = static_cast<std::uint8_t*>(ring->m_sq_ring);
+			ring->m_sq_head = reinterpret_cast<unsigned*>(sq_base + params.sq_off.head);
+			ring->m_sq_tail = reinterpret_cast<unsigned*>(sq_base + params.sq_off.tail);
+			ring->m_sq_mask = *reinterpret_cast<unsigned*>(sq_base + params.sq_off.ring_mask);
+			ring->m_sq_entries = *reinterpret_cast<unsigned*>(sq_base + params.sq_off.ring_entries);
+			ring->m_sq_array = reinterpret_cast<unsigned*>(sq_base + params.sq_off.array);
+			auto cq_base = static_cast<std::uint8_t*>(ring->m_cq_ring);
+			ring->m_cq_head = reinterpret_cast<unsigned*>(cq_base + params.cq_off.head);
+			ring->m_cq_tail = reinterpret_cast<unsigned*>(cq_base + params.cq_off.tail);
+			ring->m_cq_mask = *reinterpret_cast<unsigned*>(cq_base + params.cq_off.ring_mask);
+			ring->m_cqes = reinterpret_cast<::io_uring_cqe*>(cq_base + params.cq_off.cqes);
+			ring->m_sqe_tail = *ring->m_sq_tail;
+			return ring;
+		}
+		
+		int io_ring::fd() const{
+			return m_fd;
+		}
+		
+		unsigned io_ring::entries() const{
+			return m_sq_entries;
+		}
+		
+		::io_uring_sqe* io_ring::get_sqe(){
+			const auto head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+			if (m_sqe_tail - head >= m_sq_entries)
+				return nullptr;
+			auto sqe = &m_sqes[m_sqe_tail & m_sq_mask];
+			std::memset(sqe, 0, sizeof(*sqe));
+			m_sq_array[m_sqe_tail & m_sq_mask] = m_sqe_tail & m_sq_mask;
+			m_sqe_tail++;
+			return sqe;
+		}
+		
+		unsigned io_ring::unsubmitted() const{
+			return m_sqe_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+		}
+		
+		int io_ring::submit(unsigned wait_count){
+			// the kernel moves the head past what it takes, what an enter refused is submitted again
+			const auto to_submit = unsubmitted();
+			__atomic_store_n(m_sq_tail, m_sqe_tail, __ATOMIC_RELEASE);
+			if (to_submit == 0u and wait_count == 0u)
+				return 0;
+			auto result = 0;
+			do {
+				result = sys_io_uring_enter(m_fd, to_submit, wait_count, wait_count > 0u ? IORING_ENTER_GETEVENTS : 0u);
+			} while (result < 0 and errno == EINTR);
+			return result < 0 ? -errno : result;
+		}
+		
+		int io_ring::register_resource(unsigned opcode, const void* arg, unsigned count){
+			auto result = sys_io_uring_register(m_fd, opcode, arg, count);
+			return result < 0 ? -errno : result;
+		}
+	}
+}
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+#ifndef YA_UFTP_DETAIL_IO_RING_HPP_
+#define YA_UFTP_DETAIL_IO_RING_HPP_
+
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define YA_UFTP_HAS_IO_URING 1
+#include <linux/io_uring.h>
+#endif
+
+namespace ya_uftp{
+	namespace detail{
+#ifdef YA_UFTP_HAS_IO_URING
+		// a thin io_uring over the raw syscalls, liburing is not required.
+		// not thread safe, the owner submits and reaps from one thread
+		class io_ring{
+			struct private_ctor_tag{};
+			int				m_fd = -1;
+			void*			m_sq_ring = nullptr;
+			std::size_t		m_sq_ring_size = 0u;
+			void*			m_cq_ring = nullptr;
+			std::size_t		m_cq_ring_size = 0u;
+			::io_uring_sqe*	m_sqes = nullptr;
+			std::size_t		m_sqes_size = 0u;
+			
+			unsigned*		m_sq_head;
+			unsigned*		m_sq_tail;
+			unsigned		m_sq_mask;
+			unsigned		m_sq_entries;
+			unsigned*		m_sq_array;
+			unsigned*		m_cq_head;
+			unsigned*		m_cq_tail;
+			unsigned		m_cq_mask;
+			::io_uring_cqe*	m_cqes;
+			// the tail of the sqes prepared, the kernel takes them up to there on every enter
+			unsigned		m_sqe_tail = 0u;
+		public:
+			explicit io_ring(private_ctor_tag tag);
+			io_ring(const io_ring&) = delete;
+			io_ring& operator=(const io_ring&) = delete;
+			~io_ring();
+			
+			// nullptr when the kernel does not support or forbids io_uring
+			static std::unique_ptr<io_ring> create(unsigned entries);
+			
+			int fd() const;
+			unsigned entries() const;
+			// a cleared sqe, nullptr when the submission queue is full
+			::io_uring_sqe* get_sqe();
+			// the sqes prepared which the kernel has not taken yet, a failed enter leaves them for the next one
+			unsigned unsubmitted() const;
+			// hand the prepared sqes to the kernel and wait for at least wait_count completions,
+			// return the count the kernel took or -errno
+			int submit(unsigned wait_count = 0u);
+			// call f(const io_uring_cqe&) for every completion available, return how many
+			template<typename F>
+			unsigned consume_completions(F&& f){
+				auto head = *m_cq_head;
+				const auto tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+				auto count = 0u;
+				for (; head != tail; head++, count++)
+					f(m_cqes[head & m_cq_mask]);
+				__atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+				return count;
+			}
+			// IORING_REGISTER_* on the ring, return 0 or -errno
+			int register_resource(unsigned opcode, const void* arg, unsigned count);
+		};
+#endif
+	}
+}
+
+#endif
@@ -1,7 +1,13 @@
 #include "detail/message.hpp"
+#include "detail/block_bitmap.hpp"
+#include "detail/bit_ops.hpp"
 #include "boost/endian/conversion.hpp"
 
 #include "detail/common.hpp"
+#include <algorithm>
+#if defined(__x86_64__) or defined(__i386__)
+#include <immintrin.h>
+#endif
 
 namespace ya_uftp{
 	namespace message{
@@ -71,43 +77,145 @@ namespace ya_uftp{
 				std::chrono::system_clock::now().time_since_epoch() - std::chrono::microseconds{ts});
 		}
 		
-		// FIX-ME: if you know better way to do this, please help
-		std::set<block_index> 
-			extract_lost_blocks_ids(const api::blob_view nak_map){
-			
-			using native_uint = machine_native<>::uint;
-			auto loss_blocks_ids = std::set<block_index>{};
-			static constexpr auto bits_per_octet = 8u;
-			
-			auto native_map = api::basic_string_view<native_uint>{
-				reinterpret_cast<const native_uint*>(nak_map.data()), nak_map.size() / sizeof(native_uint)};
-			auto tail = nak_map.size() % sizeof(native_uint);
-			for (auto i = 0u; i < native_map.size(); i++){
-				if (native_map[i] != 0){
-					for (auto j = i * sizeof(native_uint); 
-						j < (i + 1) * sizeof(native_uint);
-						j++){
-						if (nak_map[j] != 0){
-							for (auto k = 0u; k < bits_per_octet; k++){
-								if ((nak_map[j] >> k) & 0x1)
-									loss_blocks_ids.emplace(j * bits_per_octet + k);
-							}
+		namespace{
+			// the extensions follow one another, each starts by its code then its length in header_length_unit
+			void find_fec_info(const std::uint8_t* ext, std::size_t length, api::optional<extension::fec_info>& info){
+				while (length >= 2u){
+					const auto ext_length = std::size_t(ext[1]) * header_length_unit;
+					if (ext_length == 0u or ext_length > length)
+						break;
+					if (static_cast<extension::code>(ext[0]) == extension::code::fec_info and 
+						ext_length >= sizeof(extension::fec_info)){
+						info.emplace();
+						info->data_blocks = ext[2];
+						info->parity_blocks = ext[3];
+						return;
+					}
+					ext += ext_length;
+					length -= ext_length;
+				}
+			}
+
+			// the map of a section never covers more blocks than a block index can tell
+			constexpr std::size_t max_nak_map_size = (std::size_t(max_block_count_per_section) + 1u) / 8u;
+
+			std::uint64_t load_nak_word(const std::uint8_t* src, std::size_t bytes){
+				auto bits = std::uint64_t(0u);
+				std::memcpy(&bits, src, bytes);
+				return boost::endian::little_to_native(bits);
+			}
+
+			block_index* append_lost(std::uint64_t bits, std::size_t first_block, block_index* out){
+				for (; bits != 0u; bits &= bits - 1)
+					*out++ = static_cast<block_index>(first_block + static_cast<std::size_t>(detail::count_trailing_zeros(bits)));
+				return out;
+			}
+
+			// a word at a time, the zero words cost a compare and each lost block a ctz
+			void extract_lost(const std::uint8_t* map, std::size_t from, std::size_t size, std::vector<block_index>& lost){
+				for (auto i = from; i < size; i += sizeof(std::uint64_t)){
+					auto bits = load_nak_word(map + i, std::min(sizeof(std::uint64_t), size - i));
+					for (; bits != 0u; bits &= bits - 1)
+						lost.push_back(static_cast<block_index>(i * 8u + static_cast<std::size_t>(detail::count_trailing_zeros(bits))));
+				}
+			}
+
+#if (defined(__x86_64__) or defined(__i386__)) and (defined(__GNUC__) or defined(__clang__))
+#define YA_UFTP_HAS_AVX2_NAK_DECODER 1
+			// the positions of the bits set in each byte value, packed at the front
+			struct byte_positions{
+				alignas(16) block_index of[256][8] = {};
+				constexpr byte_positions(){
+					for (auto value = 0u; value < 256u; value++){
+						auto count = 0u;
+						for (auto bit = 0u; bit < 8u; bit++){
+							if ((value >> bit) & 1u)
+								of[value][count++] = static_cast<block_index>(bit);
 						}
 					}
 				}
+			};
+			constexpr auto positions_table = byte_positions{};
+			// a word with this many lost blocks is expanded a byte at a time by the table instead of bit by bit
+			constexpr auto dense_word_bits = 8u;
+
+			__attribute__((target("avx2,popcnt")))
+			std::size_t count_lost_avx2(const std::uint8_t* map, std::size_t size){
+				auto count = std::size_t(0u);
+				auto i = std::size_t(0u);
+				for (; i + sizeof(__m256i) <= size; i += sizeof(__m256i)){
+					const auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(map + i));
+					if (_mm256_testz_si256(chunk, chunk))
+						continue;
+					for (auto w = i; w < i + sizeof(__m256i); w += sizeof(std::uint64_t))
+						count += static_cast<std::size_t>(detail::popcount(load_nak_word(map + w, sizeof(std::uint64_t))));
+				}
+				for (; i < size; i += sizeof(std::uint64_t))
+					count += static_cast<std::size_t>(detail::popcount(load_nak_word(map + i, std::min(sizeof(std::uint64_t), size - i))));
+				return count;
 			}
-			if (tail){
-				auto tail_head = nak_map.size() - tail;
-				for (auto j = tail_head; j < nak_map.size(); j++){
-					if (nak_map[j] != 0){
-							for (auto k = 0u; k < bits_per_octet; k++){
-								if ((nak_map[j] >> k) & 0x1)
-									loss_blocks_ids.emplace(j * bits_per_octet + k);
-							}
-						} 
+
+			// 32 bytes are skipped at once when nothing is lost there. the dense words are expanded with one store
+			// of 8 indices per byte, which writes past the indices it keeps, thus the output takes 8 more of room
+			__attribute__((target("avx2,popcnt")))
+			block_index* extract_lost_avx2(const std::uint8_t* map, std::size_t size, block_index* out){
+				auto i = std::size_t(0u);
+				for (; i + sizeof(__m256i) <= size; i += sizeof(__m256i)){
+					const auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(map + i));
+					if (_mm256_testz_si256(chunk, chunk))
+						continue;
+					for (auto w = i; w < i + sizeof(__m256i); w += sizeof(std::uint64_t)){
+						const auto bits = load_nak_word(map + w, sizeof(std::uint64_t));
+						if (bits == 0u)
+							continue;
+						if (detail::popcount(bits) < dense_word_bits){
+							out = append_lost(bits, w * 8u, out);
+							continue;
+						}
+						for (auto byte_idx = 0u; byte_idx < sizeof(std::uint64_t); byte_idx++){
+							const auto value = static_cast<unsigned>(bits >> (byte_idx * 8u)) & 0xffu;
+							const auto positions = _mm_load_si128(reinterpret_cast<const __m128i*>(positions_table.of[value]));
+							const auto first_block = _mm_set1_epi16(static_cast<short>((w + byte_idx) * 8u));
+							_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_add_epi16(positions, first_block));
+							out += detail::popcount(value);
+						}
+					}
 				}
+				for (; i < size; i += sizeof(std::uint64_t))
+					out = append_lost(load_nak_word(map + i, std::min(sizeof(std::uint64_t), size - i)), i * 8u, out);
+				return out;
+			}
+
+			bool avx2_supported(){
+				static const auto supported = __builtin_cpu_supports("avx2") and __builtin_cpu_supports("popcnt");
+				return supported;
 			}
-			return loss_blocks_ids;
+#endif
+		}
+
+		std::size_t extract_lost_blocks_ids(const api::blob_view nak_map, std::vector<block_index>& lost){
+			const auto map = nak_map.data();
+			const auto size = std::min(nak_map.size(), max_nak_map_size);
+			const auto first = lost.size();
+#ifdef YA_UFTP_HAS_AVX2_NAK_DECODER
+			if (avx2_supported()){
+				const auto count = count_lost_avx2(map, size);
+				if (count == 0u)
+					return 0u;
+				lost.resize(first + count + 8u);
+				extract_lost_avx2(map, size, lost.data() + first);
+				lost.resize(first + count);
+				return count;
+			}
+#endif
+			extract_lost(map, 0u, size, lost);
+			return lost.size() - first;
+		}
+
+		std::size_t merge_lost_blocks(const api::blob_view nak_map, std::uintmax_t block_count,
+			detail::block_bitmap& lost_blocks, std::uintmax_t first_block){
+			block_count = std::min<std::uintmax_t>(block_count, static_cast<std::uintmax_t>(nak_map.size()) * 8u);
+			return lost_blocks.merge(first_block, block_count, nak_map.data());
 		}
 		
 		validated_packet::validated_packet(const protocol_header& hdr, api::blob_span body)
@@ -159,7 +267,7 @@ namespace ya_uftp{
 					result->allowed_clients = api::basic_string_view<member_id>{
 						member_ids, count};
 				}
-				// ToDo: support parse valid extensions
+				find_fec_info(packet.data() + sizeof(announce) + addr_len, ext_length, result->fec);
 			}
 			return result;
 		}
@@ -195,7 +303,8 @@ namespace ya_uftp{
 					result->receiver_ids = api::basic_string_view<member_id>{
 						member_ids, count};
 				}
-				// ToDo: support parse valid extensions
+				if (header_len >= sizeof(receiver_register) + register_hdr->ecdh_key_length)
+					find_fec_info(packet.data() + sizeof(receiver_register) + register_hdr->ecdh_key_length, ext_length, result->fec);
 			}
 			return result;
 		}
@@ -373,6 +482,38 @@ namespace ya_uftp{
 			boost::endian::native_to_big_inplace(block_idx);
 		}
 		
+		file_parity::parsed::parsed(const file_parity& hdr) : main(hdr) {}
+		
+		api::optional<file_parity::parsed> 
+			file_parity::parse_packet(api::blob_span packet){
+			auto result = api::optional<file_parity::parsed>{};
+			auto parity_hdr = reinterpret_cast<file_parity*>(packet.data());
+			
+			if (std::uint32_t header_len = parity_hdr->header_length * header_length_unit;
+				packet.size() >= sizeof(file_parity) &&
+				parity_hdr->the_role == role::file_parity &&
+				header_len >= sizeof(file_parity) &&
+				header_len <= packet.size()){
+				
+				result.emplace(*parity_hdr);
+				
+				boost::endian::big_to_native_inplace(parity_hdr->file_id);
+				boost::endian::big_to_native_inplace(parity_hdr->section_idx);
+				boost::endian::big_to_native_inplace(parity_hdr->first_block_idx);
+				
+				if (packet.size() > header_len)
+					result->data_blob = api::blob_view{packet.data() + header_len, 
+						static_cast<std::uint32_t>(packet.size()) - header_len};
+			}
+			return result;
+		}
+		
+		void file_parity::make_transfer_ready(){
+			boost::endian::native_to_big_inplace(file_id);
+			boost::endian::native_to_big_inplace(section_idx);
+			boost::endian::native_to_big_inplace(first_block_idx);
+		}
+		
 		done::parsed::parsed(const done& hdr) : main(hdr) {}
 		
 		api::optional<done::parsed>
@@ -391,6 +532,7 @@ namespace ya_uftp{
 				
 				boost::endian::big_to_native_inplace(done_hdr->file_id);
 				boost::endian::big_to_native_inplace(done_hdr->section_idx);
+				boost::endian::big_to_native_inplace(done_hdr->section_count);
 				
 				if (packet.size() >= header_len + sizeof(member_id)){
 					const auto count = (packet.size() - header_len) / sizeof(member_id);
@@ -405,6 +547,7 @@ namespace ya_uftp{
 		void done::make_transfer_ready(){
 			boost::endian::native_to_big_inplace(file_id);
 			boost::endian::native_to_big_inplace(section_idx);
+			boost::endian::native_to_big_inplace(section_count);
 		}
 		
 		status::parsed::parsed(const status& hdr) : main(hdr) {}
@@ -4,10 +4,18 @@
 
 #include "utilities/network_intf.hpp"
 #include "api_binder.hpp"
+#include "boost/endian/conversion.hpp"
 #include <set>
+#include <vector>
 #include <limits>
+#include <array>
+#include <cstring>
 
 namespace ya_uftp{
+	namespace detail{
+		class block_bitmap;
+	}
+	
 	namespace message{
 		
 		// change to compatible with 5.0 protocol
@@ -51,6 +59,8 @@ namespace ya_uftp{
 			cc_ack = 21,
 			// New addiction to let client indicated the transfering file is already up-to-date
 			file_up_to_date = 22,
+			// New addiction, a parity block of a group of FILE_SEG, sent when the ANNOUNCE offers fec_info
+			file_parity = 23,
 			invalid
 		};
 		
@@ -72,7 +82,8 @@ namespace ya_uftp{
 				pgmcc_nak_info	=	5,
 				pgmcc_ack_info	=	6,
 				freespace_info	=	7,
-				file_hash		=	8
+				file_hash		=	8,
+				fec_info		=	9
 			};
 			
 			struct file_hash{
@@ -81,6 +92,16 @@ namespace ya_uftp{
 				std::uint16_t	reserved1 = 0u;
 				std::uint8_t	sha1_hash[20]; 
 			};
+			
+			// in ANNOUNCE, each data_blocks blocks of a section are followed by parity_blocks parity blocks.
+			// a receiver rebuilding the lost blocks from them returns it in its REGISTER
+			struct fec_info{
+				const code		the_code = code::fec_info;
+				// in header_length_unit
+				std::uint8_t	length = 1u;
+				std::uint8_t	data_blocks;
+				std::uint8_t	parity_blocks;
+			};
 		}
 		
 		enum class congestion_control_mode : std::uint8_t{
@@ -150,6 +171,7 @@ namespace ya_uftp{
 				api::variant<std::reference_wrapper<const v4_multicast_addr>, 
 					std::reference_wrapper<const v6_multicast_addr>>	mcast_addrs;
 				api::basic_string_view<member_id>						allowed_clients;
+				api::optional<extension::fec_info>						fec;
 				parsed(const announce& hdr, api::variant<std::reference_wrapper<const v4_multicast_addr>, 
 					std::reference_wrapper<const v6_multicast_addr>> mcast);
 				// ToDo: support parsing valid extensions
@@ -169,6 +191,7 @@ namespace ya_uftp{
 				const receiver_register&				main;
 				api::blob_view							key_info;
 				api::basic_string_view<member_id>		receiver_ids;
+				api::optional<extension::fec_info>		fec;
 				parsed(const receiver_register& hdr);
 				// ToDo: support parsing valid extensions
 			};
@@ -271,12 +294,34 @@ namespace ya_uftp{
 			void make_transfer_ready();
 		};
 		
+		struct file_parity{
+			const role	the_role = role::file_parity;
+			std::uint8_t	header_length;
+			file_id_type	file_id;
+			section_index	section_idx;
+			// the group is the data_blocks blocks of the section from first_block_idx on
+			block_index		first_block_idx;
+			std::uint8_t	data_blocks;
+			std::uint8_t	parity_idx;
+			std::uint16_t	reserved = 0u;
+			
+			struct parsed{
+				const file_parity&			main;
+				api::blob_view				data_blob;
+				parsed(const file_parity& hdr);
+			};
+			static api::optional<parsed> parse_packet(api::blob_span packet);
+			void make_transfer_ready();
+		};
+		
 		struct done{
 			const role	the_role = role::done;
 			std::uint8_t	header_length;
 			file_id_type	file_id;
 			section_index	section_idx;
-			std::uint16_t	reserved = 0u;
+			// zero when the file is sent through, otherwise the DONE is sent amid the first pass
+			// and asks about the section_count sections ending at section_idx only
+			std::uint16_t	section_count = 0u;
 			struct parsed {
 				const done&							main;
 				api::basic_string_view<member_id>	receiver_ids;
@@ -377,7 +422,37 @@ namespace ya_uftp{
 			validated_packet(const protocol_header&, api::blob_span body);
 		};
 		
-		std::set<block_index> extract_lost_blocks_ids(const api::blob_view nak_map);
+		// the wire image of the protocol header followed by a message header, built once and then stamped 
+		// in front of every message of the same kind. the caller patches its own per message fields afterwards
+		template<typename Header>
+		class header_template{
+			std::array<std::uint8_t, sizeof(protocol_header) + sizeof(Header)>	m_wire;
+		public:
+			protocol_header& uftp_header(){
+				return *reinterpret_cast<protocol_header*>(m_wire.data());
+			}
+			Header& header(){
+				return *reinterpret_cast<Header*>(m_wire.data() + sizeof(protocol_header));
+			}
+			static constexpr std::size_t size(){
+				return sizeof(protocol_header) + sizeof(Header);
+			}
+			Header* stamp(std::uint8_t* dest, std::uint16_t sequence_number, std::uint8_t grtt) const{
+				std::memcpy(dest, m_wire.data(), m_wire.size());
+				auto uftp_hdr = reinterpret_cast<protocol_header*>(dest);
+				uftp_hdr->sequence_number = boost::endian::native_to_big(sequence_number);
+				uftp_hdr->grtt = grtt;
+				return reinterpret_cast<Header*>(dest + sizeof(protocol_header));
+			}
+		};
+		
+		// append the blocks the NAK map of a STATUS marks lost to lost, in order. bit k of byte j is the block 8 * j + k.
+		// return the count appended
+		std::size_t extract_lost_blocks_ids(const api::blob_view nak_map, std::vector<block_index>& lost);
+		// set the bit first_block + i of lost_blocks for each block i < block_count the NAK map marks lost,
+		// return the count of them
+		std::size_t merge_lost_blocks(const api::blob_view nak_map, std::uintmax_t block_count,
+			detail::block_bitmap& lost_blocks, std::uintmax_t first_block);
 		api::optional<validated_packet> basic_validate_packet(api::blob_span packet);
 	}
 }
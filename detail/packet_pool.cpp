@@ -0,0 +1,155 @@
+#include "detail/packet_pool.hpp"
+#include <cstdlib>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace ya_uftp{
+	namespace detail{
+		namespace{
+			constexpr std::size_t round_to_cache_line(std::size_t size){
+				return (size + cache_line_size - 1) / cache_line_size * cache_line_size;
+			}
+		}
+		
+		struct packet_buffer::slab{
+			std::mutex					mutex;
+			std::vector<packet_buffer*>	free_buffers;
+			std::size_t					buffers_count = 0u;
+			// the pool is gone, the last buffer returned frees the slab
+			bool						detached = false;
+			void*						memory = nullptr;
+			std::size_t					memory_size = 0u;
+			bool						hugepages = false;
+			std::atomic<std::uint64_t>	misses = 0u;
+			
+			~slab(){
+#ifdef __linux__
+				if (hugepages){
+					::munmap(memory, memory_size);
+					return;
+				}
+#endif
+				::operator delete(memory, std::align_val_t{cache_line_size});
+			}
+			
+			void recycle(packet_buffer* buffer){
+				auto last_one = false;
+				{
+					buffer->detach();
+					std::lock_guard slab_lock(mutex);
+					buffer->m_refs.store(1u, std::memory_order_relaxed);
+					free_buffers.push_back(buffer);
+					last_one = detached and free_buffers.size() == buffers_count;
+				}
+				if (last_one)
+					delete this;
+			}
+		};
+		
+		void packet_buffer::release() noexcept{
+			if (m_refs.fetch_sub(1u, std::memory_order_acq_rel) != 1u)
+				return;
+			if (m_owner)
+				m_owner->recycle(this);
+			else{
+				this->~packet_buffer();
+				::operator delete(this, std::align_val_t{cache_line_size});
+			}
+		}
+		
+		packet_buffer* packet_buffer::allocate(std::size_t size, std::size_t capacity){
+			auto memory = ::operator new(sizeof(packet_buffer) + round_to_cache_line(capacity), std::align_val_t{cache_line_size});
+			return new (memory) packet_buffer(size, capacity, nullptr);
+		}
+		
+		packet_pool::packet_pool(std::size_t buffer_capacity, std::size_t buffers_count, bool use_hugepages) :
+			m_slab(new packet_buffer::slab),
+			m_buffer_capacity(round_to_cache_line(buffer_capacity)){
+			const auto stride = sizeof(packet_buffer) + m_buffer_capacity;
+			m_slab->memory_size = stride * buffers_count;
+			m_slab->buffers_count = buffers_count;
+#ifdef __linux__
+			if (use_hugepages and buffers_count > 0u){
+				// hugepages must be reserved by the admin(vm.nr_hugepages), quietly use the normal pages if not
+				constexpr auto huge_page_size = std::size_t(2u * 1024u * 1024u);
+				auto mapped_size = (m_slab->memory_size + huge_page_size - 1) / huge_page_size * huge_page_size;
+				auto memory = ::mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, 
+					MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+				if (memory != MAP_FAILED){
+					m_slab->memory = memory;
+					m_slab->memory_size = mapped_size;
+					m_slab->hugepages = true;
+				}
+			}
+#endif
+			if (not m_slab->memory)
+				m_slab->memory = ::operator new(m_slab->memory_size, std::align_val_t{cache_line_size});
+			
+			m_slab->free_buffers.reserve(buffers_count);
+			auto cursor = static_cast<std::uint8_t*>(m_slab->memory);
+			for (auto i = std::size_t(0u); i < buffers_count; i++, cursor += stride)
+				m_slab->free_buffers.push_back(new (cursor) packet_buffer(0u, m_buffer_capacity, m_slab));
+			// hand out the most recently freed(still cache hot) buffer first
+			std::reverse(m_slab->free_buffers.begin(), m_slab->free_buffers.end());
+		}
+		
+		packet_pool::~packet_pool(){
+			auto last_one = false;
+			{
+				std::lock_guard slab_lock(m_slab->mutex);
+				m_slab->detached = true;
+				last_one = m_slab->free_buffers.size() == m_slab->buffers_count;
+			}
+			if (last_one)
+				delete m_slab;
+		}
+		
+		message_blob_handle packet_pool::make(std::size_t size){
+			if (size <= m_buffer_capacity){
+				auto buffer = static_cast<packet_buffer*>(nullptr);
+				{
+					std::lock_guard slab_lock(m_slab->mutex);
+					if (not m_slab->free_buffers.empty()){
+						buffer = m_slab->free_buffers.back();
+						m_slab->free_buffers.pop_back();
+					}
+				}
+				if (buffer){
+					buffer->m_size = static_cast<std::uint32_t>(size);
+					return message_blob_handle{buffer};
+				}
+			}
+			m_slab->misses.fetch_add(1u, std::memory_order_relaxed);
+			return message_blob_handle{packet_buffer::allocate(size, size)};
+		}
+		
+		message_blob_handle packet_pool::make(std::size_t size, std::uint8_t value){
+			auto blob = make(size);
+			std::memset(blob->data(), value, size);
+			return blob;
+		}
+		
+		message_blob_handle packet_pool::make(const packet_buffer& from){
+			auto blob = make(from.size());
+			std::memcpy(blob->data(), from.data(), from.size());
+			return blob;
+		}
+		
+		std::size_t packet_pool::buffer_capacity() const{
+			return m_buffer_capacity;
+		}
+		
+		std::size_t packet_pool::buffers_count() const{
+			return m_slab->buffers_count;
+		}
+		
+		std::uint64_t packet_pool::misses() const{
+			return m_slab->misses.load(std::memory_order_relaxed);
+		}
+		
+		bool packet_pool::backed_by_hugepages() const{
+			return m_slab->hugepages;
+		}
+	}
+}
@@ -0,0 +1,215 @@
+#pragma once
+#ifndef YA_UFTP_DETAIL_PACKET_POOL_HPP_
+#define YA_UFTP_DETAIL_PACKET_POOL_HPP_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <algorithm>
+
+namespace ya_uftp{
+	namespace detail{
+		class packet_pool;
+
+		inline constexpr std::size_t cache_line_size = 64u;
+
+		// a fixed capacity byte buffer living in front of its payload, the payload starts on a cache line.
+		// the reference count is intrusive so handing a packet around costs no control block allocation.
+		class alignas(cache_line_size) packet_buffer{
+			friend class message_blob_handle;
+			friend class packet_pool;
+
+			struct slab;
+			std::atomic<std::uint32_t>	m_refs = 1u;
+			std::uint32_t				m_size;
+			std::uint32_t				m_capacity;
+			// nullptr when the buffer is a standalone heap allocation
+			slab*						m_owner;
+			// payload sent right after the buffer content without being copied in
+			const std::uint8_t*			m_attachment = nullptr;
+			std::uint32_t				m_attachment_size = 0u;
+			std::shared_ptr<const void>	m_attachment_owner;
+
+			packet_buffer(std::size_t size, std::size_t capacity, slab* owner) noexcept :
+				m_size(static_cast<std::uint32_t>(size)), m_capacity(static_cast<std::uint32_t>(capacity)), m_owner(owner){}
+			void add_ref() noexcept{
+				m_refs.fetch_add(1u, std::memory_order_relaxed);
+			}
+			void release() noexcept;
+		public:
+			using value_type = std::uint8_t;
+			using size_type = std::size_t;
+			using iterator = std::uint8_t*;
+			using const_iterator = const std::uint8_t*;
+
+			packet_buffer(const packet_buffer&) = delete;
+			packet_buffer& operator=(const packet_buffer&) = delete;
+
+			std::uint8_t* data() noexcept{
+				return reinterpret_cast<std::uint8_t*>(this + 1);
+			}
+			const std::uint8_t* data() const noexcept{
+				return reinterpret_cast<const std::uint8_t*>(this + 1);
+			}
+			std::size_t size() const noexcept{
+				return m_size;
+			}
+			std::size_t capacity() const noexcept{
+				return m_capacity;
+			}
+			bool empty() const noexcept{
+				return m_size == 0u;
+			}
+			// never reallocate, the size can only shrink or grow within the capacity
+			void resize(std::size_t size) noexcept{
+				m_size = static_cast<std::uint32_t>(size <= m_capacity ? size : m_capacity);
+			}
+			std::uint8_t& operator[](std::size_t idx) noexcept{
+				return data()[idx];
+			}
+			const std::uint8_t& operator[](std::size_t idx) const noexcept{
+				return data()[idx];
+			}
+			iterator begin() noexcept{
+				return data();
+			}
+			iterator end() noexcept{
+				return data() + m_size;
+			}
+			const_iterator begin() const noexcept{
+				return data();
+			}
+			const_iterator end() const noexcept{
+				return data() + m_size;
+			}
+
+			// the payload stays valid as long as the owner is held, i.e. until the buffer is released
+			void attach(const std::uint8_t* payload, std::size_t size, std::shared_ptr<const void> owner) noexcept{
+				m_attachment = payload;
+				m_attachment_size = static_cast<std::uint32_t>(size);
+				m_attachment_owner = std::move(owner);
+			}
+			void detach() noexcept{
+				m_attachment = nullptr;
+				m_attachment_size = 0u;
+				m_attachment_owner.reset();
+			}
+			const std::uint8_t* attachment() const noexcept{
+				return m_attachment;
+			}
+			std::size_t attachment_size() const noexcept{
+				return m_attachment_size;
+			}
+			
+			// standalone buffer from the heap, used when there is no pool at hand or the pool is drained
+			static packet_buffer* allocate(std::size_t size, std::size_t capacity);
+		};
+
+		// the owning handle of a packet_buffer, copy shares the buffer as the shared_ptr does
+		class message_blob_handle{
+			packet_buffer*	m_buffer = nullptr;
+		public:
+			message_blob_handle() noexcept = default;
+			message_blob_handle(std::nullptr_t) noexcept{}
+			// adopt a buffer fresh from allocate() or packet_pool::make()
+			explicit message_blob_handle(packet_buffer* buffer) noexcept : m_buffer(buffer){}
+			message_blob_handle(const message_blob_handle& from) noexcept : m_buffer(from.m_buffer){
+				if (m_buffer)
+					m_buffer->add_ref();
+			}
+			message_blob_handle(message_blob_handle&& from) noexcept : m_buffer(from.m_buffer){
+				from.m_buffer = nullptr;
+			}
+			message_blob_handle& operator=(message_blob_handle from) noexcept{
+				std::swap(m_buffer, from.m_buffer);
+				return *this;
+			}
+			~message_blob_handle(){
+				if (m_buffer)
+					m_buffer->release();
+			}
+
+			packet_buffer* get() const noexcept{
+				return m_buffer;
+			}
+			// no other handle shares the buffer, it can be reused in place
+			bool unique() const noexcept{
+				return m_buffer and m_buffer->m_refs.load(std::memory_order_acquire) == 1u;
+			}
+			packet_buffer* operator->() const noexcept{
+				return m_buffer;
+			}
+			packet_buffer& operator*() const noexcept{
+				return *m_buffer;
+			}
+			explicit operator bool() const noexcept{
+				return m_buffer != nullptr;
+			}
+			bool operator==(std::nullptr_t) const noexcept{
+				return m_buffer == nullptr;
+			}
+			bool operator!=(std::nullptr_t) const noexcept{
+				return m_buffer != nullptr;
+			}
+		};
+
+		// fixed size buffers carved out of one slab, optionally backed by hugepages.
+		// buffers can be released from any thread and may outlive the pool itself.
+		class packet_pool{
+			packet_buffer::slab*	m_slab = nullptr;
+			std::size_t				m_buffer_capacity;
+		public:
+			packet_pool(std::size_t buffer_capacity, std::size_t buffers_count, bool use_hugepages = false);
+			packet_pool(const packet_pool&) = delete;
+			packet_pool& operator=(const packet_pool&) = delete;
+			~packet_pool();
+
+			// fallback to the heap when the pool is drained or the size does not fit, the content is not zeroed
+			message_blob_handle make(std::size_t size);
+			message_blob_handle make(std::size_t size, std::uint8_t value);
+			message_blob_handle make(const packet_buffer& from);
+
+			std::size_t buffer_capacity() const;
+			std::size_t buffers_count() const;
+			// how many times make() had to fallback to the heap
+			std::uint64_t misses() const;
+			bool backed_by_hugepages() const;
+		};
+	}
+
+	using message_blob = detail::message_blob_handle;
+
+	inline message_blob make_message_blob(std::size_t size){
+		auto blob = message_blob{detail::packet_buffer::allocate(size, size)};
+		std::memset(blob->data(), 0, size);
+		return blob;
+	}
+
+	inline message_blob make_message_blob(std::size_t size, std::uint8_t value){
+		auto blob = message_blob{detail::packet_buffer::allocate(size, size)};
+		std::memset(blob->data(), value, size);
+		return blob;
+	}
+
+	inline message_blob make_message_blob(const detail::packet_buffer& from){
+		auto blob = message_blob{detail::packet_buffer::allocate(from.size(), from.size())};
+		std::memcpy(blob->data(), from.data(), from.size());
+		return blob;
+	}
+
+	template<typename Iter>
+	message_blob make_message_blob(Iter first, Iter last){
+		auto size = static_cast<std::size_t>(last - first);
+		auto blob = message_blob{detail::packet_buffer::allocate(size, size)};
+		std::copy(first, last, blob->data());
+		return blob;
+	}
+}
+
+#endif
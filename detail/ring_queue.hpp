@@ -0,0 +1,61 @@
+#pragma once
+#ifndef YA_UFTP_DETAIL_RING_QUEUE_HPP_
+#define YA_UFTP_DETAIL_RING_QUEUE_HPP_
+
+#include "api_binder.hpp"
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+namespace ya_uftp{
+	namespace detail{
+		// FIFO on a circular buffer, it grows as needed and never gives the memory back,
+		// so a queue in steady state does not touch the heap as the std::deque does.
+		template<typename T>
+		class ring_queue{
+			std::vector<api::optional<T>>	m_slots;
+			std::size_t						m_head = 0u;
+			std::size_t						m_size = 0u;
+			
+			void grow(){
+				auto slots = std::vector<api::optional<T>>(m_slots.empty() ? 64u : m_slots.size() * 2);
+				for (auto i = std::size_t(0u); i < m_size; i++){
+					auto& from = m_slots[(m_head + i) % m_slots.size()];
+					slots[i].emplace(std::move(*from));
+					from.reset();
+				}
+				m_slots = std::move(slots);
+				m_head = 0u;
+			}
+		public:
+			explicit ring_queue(std::size_t initial_capacity = 64u) : m_slots(initial_capacity){}
+			
+			bool empty() const{
+				return m_size == 0u;
+			}
+			std::size_t size() const{
+				return m_size;
+			}
+			T& front(){
+				return *m_slots[m_head];
+			}
+			void pop(){
+				m_slots[m_head].reset();
+				m_head = (m_head + 1) % m_slots.size();
+				m_size--;
+			}
+			template<typename... Args>
+			void emplace(Args&&... args){
+				if (m_size == m_slots.size())
+					grow();
+				m_slots[(m_head + m_size) % m_slots.size()].emplace(std::forward<Args>(args)...);
+				m_size++;
+			}
+			void push(T&& item){
+				emplace(std::move(item));
+			}
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,75 @@
+#pragma once
+#ifndef YA_UFTP_DETAIL_SPSC_RING_HPP_
+#define YA_UFTP_DETAIL_SPSC_RING_HPP_
+
+#include "api_binder.hpp"
+#include "detail/packet_pool.hpp"
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+namespace ya_uftp{
+	namespace detail{
+		// bounded lock free FIFO between exactly one producer thread and one consumer thread.
+		// the indices only grow, the slot is the index masked by the power of two capacity.
+		template<typename T>
+		class spsc_ring{
+			// written by the consumer only
+			alignas(cache_line_size) std::atomic<std::size_t>	m_head = 0u;
+			// written by the producer only
+			alignas(cache_line_size) std::atomic<std::size_t>	m_tail = 0u;
+			alignas(cache_line_size) std::vector<api::optional<T>>	m_slots;
+			std::size_t											m_mask;
+
+			static std::size_t round_up(std::size_t capacity){
+				auto rounded = std::size_t(1u);
+				while (rounded < capacity)
+					rounded <<= 1;
+				return rounded;
+			}
+		public:
+			explicit spsc_ring(std::size_t capacity) :
+				m_slots(round_up(capacity)), m_mask(m_slots.size() - 1){}
+			spsc_ring(const spsc_ring&) = delete;
+			spsc_ring& operator=(const spsc_ring&) = delete;
+
+			std::size_t capacity() const{
+				return m_slots.size();
+			}
+
+			// producer side
+			bool full() const{
+				return m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_acquire) == m_slots.size();
+			}
+			template<typename... Args>
+			bool try_emplace(Args&&... args){
+				const auto tail = m_tail.load(std::memory_order_relaxed);
+				if (tail - m_head.load(std::memory_order_acquire) == m_slots.size())
+					return false;
+				m_slots[tail & m_mask].emplace(std::forward<Args>(args)...);
+				m_tail.store(tail + 1, std::memory_order_release);
+				return true;
+			}
+
+			// consumer side
+			bool empty() const{
+				return m_head.load(std::memory_order_relaxed) == m_tail.load(std::memory_order_acquire);
+			}
+			// nullptr when empty
+			T* front(){
+				const auto head = m_head.load(std::memory_order_relaxed);
+				if (head == m_tail.load(std::memory_order_acquire))
+					return nullptr;
+				return &*m_slots[head & m_mask];
+			}
+			void pop(){
+				const auto head = m_head.load(std::memory_order_relaxed);
+				m_slots[head & m_mask].reset();
+				m_head.store(head + 1, std::memory_order_release);
+			}
+		};
+	}
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "ya_uftp.hpp"
 #include <iostream>
+#include <thread>
 
 int main(int argc, char *argv[]){
 	if (argc > 1){
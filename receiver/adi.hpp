@@ -14,6 +14,17 @@ namespace ya_uftp{
 				failed_max_tasks_monitoring
 			};
 			
+			enum class write_backend{
+				// pwritev() through the page cache
+				buffered,
+				// O_DIRECT from aligned staging buffers(Linux only), the unaligned edges of a run go through the page cache.
+				// falls back to buffered when the file system refuses O_DIRECT
+				direct,
+				// writev through one io_uring per disk thread, shared by all the sessions it writes for(Linux only).
+				// falls back to buffered when the kernel refuses io_uring
+				io_uring
+			};
+			
 			enum status
             {
 				waiting_registration_confirm,
@@ -22,11 +33,47 @@ namespace ya_uftp{
 				complete
 			};
 
+			struct statistics{
+				std::uint64_t	datagrams_received = 0u;
+				// the counters of the receive socket, kernel drops and receive ring below included, cover
+				// all the sessions on the listen port, which share the socket
+				std::uint64_t	receive_syscalls = 0u;
+				// datagrams the kernel dropped as the socket receive buffer was full, 
+				// learnt by SO_RXQ_OVFL from the batched receive only(Linux only)
+				std::uint64_t	kernel_drops = 0u;
+				// datagrams which arrived coalesced with others into one read by UDP_GRO
+				std::uint64_t	coalesced_datagrams = 0u;
+				// packets which did not fit or found the packet pool drained, thus allocated from the heap
+				std::uint64_t	packet_pool_misses = 0u;
+				// buffers of the receive ring, and the reads which found it drained, thus allocated from the heap
+				std::uint64_t	receive_ring_buffers = 0u;
+				std::uint64_t	receive_ring_misses = 0u;
+				// writes issued to the disk, each covers a run of contiguous blocks
+				std::uint64_t	disk_writes = 0u;
+				// blocks received again after they had been received, they are dropped before the disk
+				std::uint64_t	duplicate_blocks = 0u;
+				// blocks dropped as the pending writes were over the budget, the sender resends them on NAK
+				std::uint64_t	dropped_blocks = 0u;
+				// blocks lost but rebuilt from the parity of their group, never asked for again
+				std::uint64_t	rebuilt_blocks = 0u;
+				// bytes received but not written yet by this session(now and the most so far), and by all sessions
+				std::uint64_t	pending_write_bytes = 0u;
+				std::uint64_t	pending_write_peak = 0u;
+				std::uint64_t	process_pending_write_bytes = 0u;
+				// blocks received straight into the mapped destination, and those copied to their place as they were
+				// not the block predicted, or were read into the receive ring
+				std::uint64_t	placed_blocks = 0u;
+				std::uint64_t	misplaced_blocks = 0u;
+				// tell how well the incoming datagrams are batched, 1.0 means no batching at all
+				double datagrams_per_syscall() const;
+			};
+
 			struct progress
             {
                 std::uint32_t session_id;
                 status current_status;
                 api::fs::path current_file;
+				statistics		stats;
 				using listener = std::function<void(progress )>;
             };
 
@@ -38,8 +85,17 @@ namespace ya_uftp{
 				bool						inplace_tmp_file = false;
 				boost::asio::ip::address	public_multicast_addr = boost::asio::ip::make_address_v4("230.4.4.1");
 				
+				// the sessions of the process on the same listen port share one socket, which every datagram is read from
+				// once. its receive options below are those of the monitor which first opens the port, 
+				// the others are logged and ignored
 				std::size_t					udp_buffer_size = 256 * 1024;
 				std::uint16_t				listen_port = 1044;
+				// datagrams drained by one recvmmsg() each time the socket turns readable(Linux only),
+				// 1 reads them one by one
+				std::size_t					receive_batch_size = 32u;
+				// let the kernel coalesce consecutive datagrams of the sender into one read by UDP_GRO(Linux only),
+				// the read is split back into the datagrams in place. each batch slot then takes 64KB
+				bool						enable_udp_gro = false;
 				
 				std::uint8_t				packets_ttl = 1;
 				api::optional<std::uint32_t>	client_id;
@@ -50,6 +106,39 @@ namespace ya_uftp{
 				
 				bool						follow_symbolic_link = false;
 				bool						quit_on_error = false;
+				// bytes of preallocated buffers the datagrams are received into, one ring for all the sessions on the listen port.
+				// a buffer holds a datagram(or a coalesced read with GRO) and is handed to the disk thread as is until its block is written
+				std::size_t					receive_ring_size = 8 * 1024 * 1024;
+				// the received blocks are kept until a contiguous run of this many bytes can be written at once,
+				// the writes are cut at the file system block boundaries
+				std::size_t					write_run_size = 256 * 1024;
+				// bytes received but not written yet a session may hold, and all sessions of the process together.
+				// the blocks over the budget are dropped and NAKed later, the receive buffers stay bounded on slow disks
+				std::size_t					write_budget = 32 * 1024 * 1024;
+				std::size_t					process_write_budget = 256 * 1024 * 1024;
+				// how the received blocks are written to the disk
+				write_backend				file_write_backend = write_backend::buffered;
+				// fallocate() the whole size announced by FILEINFO before the first write(Linux only), 
+				// which keeps large files in few extents on ext4/XFS
+				bool						preallocate_files = false;
+				// start the writeback of each run once written, and drop the run before it from the page cache.
+				// not applied to the writes through io_uring
+				bool						drop_written_pages = false;
+				// preallocate and map the destination file, then receive the payload of the block expected next straight
+				// into its place, bypassing the receive ring and the disk thread(Linux only). needs the batched receive
+				// without UDP_GRO, falls back to the writes when the file can not be mapped. the session then runs in the thread
+				// reading the socket of the port, instead of a network thread of its own
+				bool						map_destination_file = false;
+				// count of preallocated packet buffers per session for the messages sent to the sender
+				std::size_t					packet_pool_size = 256u;
+				// back the packet pool by hugepages when the system has them reserved
+				bool						packet_pool_hugepages = false;
+				// take the parity blocks the sender offers in its ANNOUNCE, and rebuild the lost blocks of a group
+				// from them without asking for them again
+				bool						accept_fec = true;
+				// bytes of the groups left with lost blocks kept until the parity repairs of the sender rebuild them.
+				// a group past it is dropped, its parity repair is then wasted and the blocks are resent
+				std::size_t					parity_memory = 64 * 1024 * 1024;
 				
 				// ------ start of Not-Yet-Supported features ------
 				bool						enforce_encryption = false;
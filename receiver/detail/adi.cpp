@@ -8,5 +8,9 @@ namespace ya_uftp::receiver{
 		parameters& parameters::operator=(const parameters&) = default;
 		parameters& parameters::operator=(parameters&&) = default;
 		parameters::~parameters() = default;
+		
+		double statistics::datagrams_per_syscall() const{
+			return receive_syscalls > 0u ? static_cast<double>(datagrams_received) / receive_syscalls : 0.0;
+		}
 	}
 }
@@ -7,7 +7,7 @@
 #include "detail/message.hpp"
 
 #include "receiver/detail/files_accept_session.hpp"
-#include <array>
+#include "receiver/detail/port_listener.hpp"
 
 namespace ya_uftp::receiver::detail{
 	class announcement_monitor :
@@ -19,20 +19,22 @@ namespace ya_uftp::receiver::detail{
 			std::weak_ptr<files_accept_session>		pointer;
 		};
 
-		boost::asio::ip::udp::socket	m_socket;
-		boost::asio::io_context&		m_net_io_ctx;
+		// the announcements come through the socket of the port, shared with the sessions
+		std::shared_ptr<port_listener>	m_listener;
+		api::optional<std::uint32_t>	m_subscription;
 		boost::asio::io_context&		m_file_io_ctx;
-		std::array<std::uint8_t, 1500>	m_msg_buffer;
-		boost::asio::ip::udp::endpoint	m_sender_ep;
 		task::parameters				m_params;
 		std::map<boost::asio::ip::address, session_prop>	m_known_announcements;
 		
-		void do_monitor_announcement();
+		void on_announcement(const message::validated_packet& valid_msg, const boost::asio::ip::udp::endpoint& sender_ep);
+		// the network thread a new session runs in
+		boost::asio::io_context& session_net_context();
 	public:
 		announcement_monitor(boost::asio::io_context& net_io_ctx, 
 			boost::asio::io_context& file_io_ctx,
 			const task::parameters& params,  
 			private_ctor_tag tag);
+		~announcement_monitor();
 			
 		void run();
 		void stop();
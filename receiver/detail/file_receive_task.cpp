@@ -4,7 +4,9 @@
 
 #include "detail/progress_notification.hpp"
 #include <type_traits>
+#include <algorithm>
 #include <iostream>
+#include <cstring>
 #include "boost/endian/conversion.hpp"
 
 namespace ya_uftp {
@@ -48,7 +50,7 @@ namespace ya_uftp {
             }
 
             std::uint8_t files_accept_session::file_receive_task::on_message_received(
-                message::validated_packet valid_packet)
+                message::validated_packet valid_packet, const message_blob& packet_buffer)
             {
 				auto grtt_factor = std::uint8_t(5);
 				switch (valid_packet.msg_header.message_role) {
@@ -57,7 +59,11 @@ namespace ya_uftp {
 					grtt_factor = 5;
 					break;
 				case message::role::file_seg:
-					on_data_block_received(valid_packet.msg_body, valid_packet.msg_header.source_id);
+					on_data_block_received(valid_packet.msg_body, valid_packet.msg_header.source_id, packet_buffer);
+					grtt_factor = 3;
+					break;
+				case message::role::file_parity:
+					on_parity_received(valid_packet.msg_body, packet_buffer);
 					grtt_factor = 3;
 					break;
 				case message::role::done:
@@ -90,7 +96,9 @@ namespace ya_uftp {
 									m_last_fileinfo_ts_low = file_info_msg->main.msg_timestamp_usecs_low;
                                     m_file_ts = (static_cast<std::uint64_t>(file_info_msg->main.timestamp_high) << 32) +
                                                 file_info_msg->main.timestamp_low;
-									m_completed_sections.resize(m_section_count);
+									m_missing_blocks.assign(m_block_count, true);
+									m_received_per_section.assign(m_section_count, 0u);
+									m_completed_section_count = 0u;
 									auto target_path = api::fs::path{ std::string{file_info_msg->name.data(), file_info_msg->name.size()} }.lexically_normal();
 
 									auto ec = api::error_code{};
@@ -171,7 +179,7 @@ namespace ya_uftp {
                                         if (ondisk_filesize == file_size and 
 											ondisk_file_ts == m_file_ts)
                                         {
-                                            core::detail::progress_notification::get().post_progress({id(), task::status::complete, m_file_path});
+                                            core::detail::progress_notification::get().post_progress({id(), task::status::complete, m_file_path, m_worker.statistics()});
                                             m_phase = phase::completed;
                                             do_report_complete();
                                         }
@@ -180,9 +188,15 @@ namespace ya_uftp {
                                             // std::cout << "Openning file " << m_file_path.string() << " for
                                             // download\n";
                                             core::detail::progress_notification::get().post_progress(
-                                                {id(), task::status::receiving_data, m_file_path});
-                                            m_file_stream.open(m_file_path.string(),
-                                                               std::ios_base::binary | std::ios_base::out);
+                                                {id(), task::status::receiving_data, m_file_path, m_worker.statistics()});
+                                            if (m_context.map_destination_file)
+                                                m_mapped = mapped_destination::open(m_file_path, m_file_size);
+                                            if (not m_mapped)
+                                                m_writer = block_writer::open(m_file_path, write_options{m_context.file_write_backend,
+                                                    m_context.preallocate_files ? m_file_size : 0u, m_context.drop_written_pages,
+                                                    m_worker.file_write_ring()});
+                                            m_write_behind.emplace(m_worker.pending_writes(), m_context.write_run_size, 
+                                                m_writer ? m_writer->alignment() : 0u);
                                             m_phase = phase::receiving_blobs;
                                             do_report_file_info_ack();
                                         }
@@ -286,7 +300,8 @@ namespace ya_uftp {
 				}
 			}
 
-			void files_accept_session::file_receive_task::on_data_block_received(api::blob_span packet, message::member_id source_id){
+			void files_accept_session::file_receive_task::on_data_block_received(api::blob_span packet, message::member_id source_id,
+				const message_blob& packet_buffer){
 				if (m_phase == phase::receiving_blobs) {
 					auto data_block_msg = message::file_seg::parse_packet(packet);
 					if (data_block_msg) {
@@ -294,39 +309,118 @@ namespace ya_uftp {
 							data_block_msg->main.file_id == m_file_id) {
 							const auto sect_idx = data_block_msg->main.section_idx;
 							const auto blk_idx = data_block_msg->main.block_idx;
-							const auto sect_blk_count = section_block_count(sect_idx);
+							if (sect_idx >= m_section_count or blk_idx >= section_block_count(sect_idx))
+								return;
 							auto block_idx = sect_blk_to_abs_block_idx(sect_idx, blk_idx);
 
-							auto data_copy = make_message_blob(data_block_msg->data_blob.size());
-							std::copy(data_block_msg->data_blob.begin(), data_block_msg->data_blob.end(), data_copy->begin());
-							m_worker.execute_in_file_thread([data_copy = std::move(data_copy), offset = block_idx * m_context.block_size, this_task = shared_from_this()](){
-								this_task->m_file_stream.seekp(offset);
-								this_task->m_file_stream.write(reinterpret_cast<const char*>(data_copy->data()),
-									data_copy->size());
-							});
-							
-							auto record_it = m_blocks_per_section_completion_record.find(sect_idx);
-							if (record_it == m_blocks_per_section_completion_record.end()) {
-
-								auto [it, inserted] = m_blocks_per_section_completion_record.emplace(sect_idx,
-									received_record{ boost::dynamic_bitset<std::uint8_t>{sect_blk_count}, 0u });
-								assert(inserted);
-								
-								record_it = it;
-								record_it->second.missing_blocks.set();
+							// a retransmission of a block we have already, it never reaches the disk queue
+							if (not m_missing_blocks.test(block_idx)) {
+								m_worker.on_duplicate_block();
+								return;
 							}
-							record_it->second.missing_blocks[blk_idx] = false;
-							record_it->second.count++;
-							if (record_it->second.count >= sect_blk_count and
-								// avoid completion checks when obviously not all blocks received 
-								record_it->second.missing_blocks.none()) {
-								m_completed_sections[sect_idx] = true;
+							if (m_mapped) {
+								// a block which missed the place predicted for it
+								if (data_block_msg->data_blob.size() != block_length(block_idx))
+									return;
+								std::memcpy(m_mapped->data() + block_idx * m_context.block_size, 
+									data_block_msg->data_blob.data(), data_block_msg->data_blob.size());
+								m_worker.on_placed_block(false);
+								keep_for_parity(block_idx, api::blob_view{ m_mapped->data() + block_idx * m_context.block_size, 
+									data_block_msg->data_blob.size() }, nullptr);
+							}
+							else {
+								// over the budget the block is left missing, the next STATUS NAKs it
+								if (not m_write_behind->reserve(data_block_msg->data_blob.size())) {
+									// the run kept may hold the whole budget, write it out or nothing is ever given back
+									if (auto run = m_write_behind->take(); run)
+										do_write_run(std::move(run.value()));
+									m_worker.on_block_dropped();
+									return;
+								}
+								// the block is kept in the receive buffer until its run is written
+								if (auto run = m_write_behind->add(packet_buffer, data_block_msg->data_blob, 
+									block_idx * m_context.block_size); run)
+									do_write_run(std::move(run.value()));
+								keep_for_parity(block_idx, data_block_msg->data_blob, packet_buffer);
 							}
+							m_next_block = block_idx + 1;
+							on_block_stored(sect_idx, block_idx);
 						}
 					}
 				}
 			}
 
+			api::optional<worker::employer::placement> files_accept_session::file_receive_task::predict_placement(){
+				if (m_phase != phase::receiving_blobs or not m_mapped or m_next_block >= m_block_count)
+					return api::nullopt;
+				// in order traffic goes on with the block next to the last one, a repair pass with the next missing
+				// block of the same section
+				auto block_idx = m_next_block;
+				if (not m_missing_blocks.test(block_idx)) {
+					auto [sect_idx, blk_idx] = abs_block_idx_to_sect_blk(block_idx);
+					const auto section_end = block_idx - blk_idx + section_block_count(sect_idx);
+					block_idx = m_missing_blocks.find_next(block_idx, section_end);
+					if (block_idx == section_end)
+						return api::nullopt;
+				}
+				m_predicted_block = block_idx;
+				return placement{ m_mapped->data() + block_idx * m_context.block_size, block_length(block_idx) };
+			}
+
+			std::uint8_t files_accept_session::file_receive_task::on_block_placed(message::validated_packet valid_packet, 
+				api::blob_span payload){
+				const auto grtt_factor = std::uint8_t(3);
+				auto data_block_msg = message::file_seg::parse_packet(valid_packet.msg_body);
+				if (m_phase != phase::receiving_blobs or not data_block_msg or
+					data_block_msg->main.file_id == 0u or data_block_msg->main.file_id != m_file_id)
+					return grtt_factor;
+				const auto sect_idx = data_block_msg->main.section_idx;
+				const auto blk_idx = data_block_msg->main.block_idx;
+				if (sect_idx >= m_section_count or blk_idx >= section_block_count(sect_idx))
+					return grtt_factor;
+				auto block_idx = sect_blk_to_abs_block_idx(sect_idx, blk_idx);
+				
+				if (not m_missing_blocks.test(block_idx)) {
+					m_worker.on_duplicate_block();
+					return grtt_factor;
+				}
+				if (payload.size() != block_length(block_idx))
+					return grtt_factor;
+				// mispredicted, the payload sits in the place of a block still missing
+				if (block_idx != m_predicted_block)
+					std::memcpy(m_mapped->data() + block_idx * m_context.block_size, payload.data(), payload.size());
+				m_worker.on_placed_block(block_idx == m_predicted_block);
+				keep_for_parity(block_idx, api::blob_view{ m_mapped->data() + block_idx * m_context.block_size, payload.size() }, nullptr);
+				m_next_block = block_idx + 1;
+				on_block_stored(sect_idx, block_idx);
+				return grtt_factor;
+			}
+
+			std::size_t files_accept_session::file_receive_task::block_length(std::uintmax_t block_idx) const{
+				return static_cast<std::size_t>(std::min<std::uintmax_t>(m_context.block_size, 
+					m_file_size - block_idx * m_context.block_size));
+			}
+
+			void files_accept_session::file_receive_task::on_block_stored(message::section_index sect_idx, std::uintmax_t block_idx){
+				// only a missing block is stored, so the count reaches the section size exactly once
+				m_missing_blocks.reset(block_idx);
+				if (++m_received_per_section[sect_idx] == section_block_count(sect_idx))
+					m_completed_section_count++;
+			}
+
+			bool files_accept_session::file_receive_task::section_complete(message::section_index sect_idx){
+				return m_received_per_section[sect_idx] == section_block_count(sect_idx);
+			}
+
+			void files_accept_session::file_receive_task::report_sections_status(message::section_index last_sect_idx, std::uint32_t count){
+				const auto first = last_sect_idx + 1u > count ? last_sect_idx + 1u - count : 0u;
+				for (auto sect_idx = first; sect_idx <= last_sect_idx and sect_idx < m_section_count; sect_idx++) {
+					if (not section_complete(sect_idx)) {
+						do_report_status(sect_idx);
+					}
+				}
+			}
+
 			void files_accept_session::file_receive_task::on_done_received(api::blob_span packet, message::member_id source_id){
 				
 				auto done_msg = message::done::parse_packet(packet);
@@ -335,36 +429,49 @@ namespace ya_uftp {
 						done_msg->main.file_id == m_file_id) {
 						auto id_pos = done_msg->receiver_ids.find(m_context.in_group_id);
 						if (id_pos != api::basic_string_view<message::member_id>::npos) {
-							if (m_completed_sections.all()) {
+							if (done_msg->main.section_count > 0u) {
+								// the sender is still going through the file, only these sections are asked about
+								if (m_phase == phase::receiving_blobs)
+									report_sections_status(done_msg->main.section_idx, done_msg->main.section_count);
+							}
+							else if (m_completed_section_count == m_section_count) {
                                 
+                                if (auto run = m_write_behind->take(); run)
+                                    do_write_run(std::move(run.value()));
                                 m_worker.execute_in_file_thread([this_task = shared_from_this()]() {
-                                    auto ec = api::error_code{};
-                                    this_task->m_file_stream.close();
-                                    if (not this_task->m_final_dest_path.empty())
-                                    {
-                                        api::fs::rename(this_task->m_file_path, this_task->m_final_dest_path, ec);
-                                        api::fs::last_write_time(this_task->m_final_dest_path,
-                                                                 api::convert_file_time(this_task->m_file_ts), ec);
-                                    }
+                                    auto finalize = [this_task]() {
+                                        auto ec = api::error_code{};
+                                        this_task->m_writer.reset();
+                                        this_task->m_mapped.reset();
+                                        if (not this_task->m_final_dest_path.empty())
+                                        {
+                                            api::fs::rename(this_task->m_file_path, this_task->m_final_dest_path, ec);
+                                            api::fs::last_write_time(this_task->m_final_dest_path,
+                                                                     api::convert_file_time(this_task->m_file_ts), ec);
+                                        }
+                                        else
+                                        {
+                                            api::fs::last_write_time(this_task->m_file_path,
+                                                                     api::convert_file_time(this_task->m_file_ts), ec);
+                                            if (ec)
+                                                std::cout << "Failed to set last write time of " << this_task->m_file_path
+                                                          << ", reason is " << ec.message() << '\n';
+                                        }
+                                    };
+                                    // the writes still in flight would touch the file after its time is set
+                                    if (this_task->m_writer)
+                                        this_task->m_writer->finish(std::move(finalize));
                                     else
-                                    {
-                                        api::fs::last_write_time(this_task->m_file_path,
-                                                                 api::convert_file_time(this_task->m_file_ts), ec);
-                                        if (ec)
-                                            std::cout << "Failed to set last write time of " << this_task->m_file_path
-                                                      << ", reason is " << ec.message() << '\n';
-									}
+                                        finalize();
                                 });
                                 
+								core::detail::progress_notification::get().post_progress(
+									{id(), task::status::complete, m_file_path, m_worker.statistics()});
 								m_phase = phase::completed;
 								do_report_complete();
 							}
 							else {
-								for (auto sect_idx = 0u; sect_idx <= done_msg->main.section_idx; sect_idx++) {
-									if (not m_completed_sections[sect_idx]) {
-										do_report_status(sect_idx);
-									}
-								}
+								report_sections_status(done_msg->main.section_idx, done_msg->main.section_idx + 1u);
 							}
 						}
 						else {
@@ -396,6 +503,153 @@ namespace ya_uftp {
 				}
 			}
 
+			files_accept_session::file_receive_task::parity_groups::iterator
+				files_accept_session::file_receive_task::open_parity_group(std::uintmax_t block_idx){
+				// the group left behind is kept for the parity repairs only while the memory allows
+				if (auto last = m_parity_groups.find(m_parity_first); 
+					last != m_parity_groups.end() and m_parity_bytes > m_context.parity_memory)
+					close_parity_group(last);
+				// the groups are cut from the start of each section, the last one of a section is shorter
+				const auto data_count = std::size_t(m_context.fec->data_blocks);
+				auto [sect_idx, blk_idx] = abs_block_idx_to_sect_blk(block_idx);
+				const auto first_blk = blk_idx / data_count * data_count;
+				m_parity_first = block_idx - (blk_idx - first_blk);
+				auto group = m_parity_groups.try_emplace(m_parity_first).first;
+				group->second.size = std::min<std::size_t>(data_count, section_block_count(sect_idx) - first_blk);
+				group->second.blocks.resize(group->second.size);
+				m_parity_end = m_parity_first + group->second.size;
+				return group;
+			}
+
+			files_accept_session::file_receive_task::parity_groups::iterator
+				files_accept_session::file_receive_task::find_parity_group(std::uintmax_t block_idx){
+				if (block_idx >= m_parity_end)
+					return open_parity_group(block_idx);
+				auto group = m_parity_groups.upper_bound(block_idx);
+				if (group == m_parity_groups.begin())
+					return m_parity_groups.end();
+				--group;
+				return block_idx < group->first + group->second.size ? group : m_parity_groups.end();
+			}
+
+			void files_accept_session::file_receive_task::close_parity_group(parity_groups::iterator group){
+				// a block kept holds its receive buffer, it counts as a block size
+				const auto& kept = group->second;
+				m_parity_bytes -= (kept.data_received + kept.parity_rows.size()) * m_context.block_size;
+				m_parity_groups.erase(group);
+			}
+
+			void files_accept_session::file_receive_task::keep_for_parity(std::uintmax_t block_idx, api::blob_view payload, 
+				const message_blob& owner){
+				if (not m_context.fec)
+					return;
+				// a group already rebuilt or dropped
+				auto group = find_parity_group(block_idx);
+				if (group == m_parity_groups.end())
+					return;
+				auto& kept = group->second;
+				const auto i = static_cast<std::size_t>(block_idx - group->first);
+				if (kept.received[i])
+					return;
+				kept.blocks[i] = kept_block{ owner, payload };
+				kept.received[i] = true;
+				m_parity_bytes += m_context.block_size;
+				// nothing is left for the parity to rebuild
+				if (++kept.data_received == kept.size)
+					close_parity_group(group);
+			}
+
+			void files_accept_session::file_receive_task::on_parity_received(api::blob_span packet, 
+				const message_blob& packet_buffer){
+				if (m_phase != phase::receiving_blobs or not m_context.fec)
+					return;
+				auto parity_msg = message::file_parity::parse_packet(packet);
+				if (not parity_msg or parity_msg->main.file_id == 0u or parity_msg->main.file_id != m_file_id)
+					return;
+				const auto codec = ya_uftp::detail::fec_codec{ m_context.fec->data_blocks, m_context.fec->parity_blocks };
+				const auto sect_idx = parity_msg->main.section_idx;
+				const auto first_blk = parity_msg->main.first_block_idx;
+				const auto row = parity_msg->main.parity_idx;
+				if (sect_idx >= m_section_count or first_blk >= section_block_count(sect_idx) or
+					first_blk % codec.data_count() != 0u or row >= codec.max_parity_count() or
+					parity_msg->data_blob.size() != m_context.block_size)
+					return;
+				const auto first = sect_blk_to_abs_block_idx(sect_idx, first_blk);
+				auto group = find_parity_group(first);
+				if (group == m_parity_groups.end() or group->first != first or parity_msg->main.data_blocks != group->second.size)
+					return;
+				
+				auto& kept = group->second;
+				if (std::find(kept.parity_rows.begin(), kept.parity_rows.end(), row) == kept.parity_rows.end()) {
+					kept.parity_rows.push_back(row);
+					kept.blocks.push_back(kept_block{ packet_buffer, parity_msg->data_blob });
+					m_parity_bytes += m_context.block_size;
+				}
+				if (kept.data_received + kept.parity_rows.size() < kept.size)
+					return;
+				// the decode works in place, the blocks are copied out of their buffers. the last block of the file
+				// is coded as if padded by zeros
+				auto work = std::vector<std::uint8_t>(kept.blocks.size() * m_context.block_size, 0u);
+				auto data = std::array<std::uint8_t*, ya_uftp::detail::fec_codec::max_symbols>{};
+				auto parity = std::array<std::uint8_t*, ya_uftp::detail::fec_codec::max_symbols>{};
+				for (auto i = std::size_t(0u); i < kept.blocks.size(); i++) {
+					const auto slot = work.data() + i * m_context.block_size;
+					if (not kept.blocks[i].payload.empty())
+						std::memcpy(slot, kept.blocks[i].payload.data(), kept.blocks[i].payload.size());
+					if (i < kept.size)
+						data[i] = slot;
+					else
+						parity[kept.parity_rows[i - kept.size]] = slot;
+				}
+				if (not codec.decode(kept.size, data.data(), kept.received.data(), parity.data(), 
+					codec.max_parity_count(), m_context.block_size))
+					return;
+				
+				for (auto i = std::size_t(0u); i < kept.size; i++) {
+					if (not kept.received[i] and m_missing_blocks.test(group->first + i))
+						store_rebuilt_block(group->first + i, data[i]);
+				}
+				close_parity_group(group);
+			}
+
+			void files_accept_session::file_receive_task::store_rebuilt_block(std::uintmax_t block_idx, const std::uint8_t* data){
+				const auto length = block_length(block_idx);
+				if (m_mapped) {
+					std::memcpy(m_mapped->data() + block_idx * m_context.block_size, data, length);
+				}
+				else {
+					// over the budget the block is left missing, the next STATUS NAKs it
+					if (not m_write_behind->reserve(length)) {
+						if (auto run = m_write_behind->take(); run)
+							do_write_run(std::move(run.value()));
+						m_worker.on_block_dropped();
+						return;
+					}
+					auto owner = make_message_blob(length);
+					std::memcpy(owner->data(), data, length);
+					if (auto run = m_write_behind->add(owner, api::blob_view{ owner->data(), length }, 
+						block_idx * m_context.block_size); run)
+						do_write_run(std::move(run.value()));
+				}
+				m_worker.on_block_rebuilt();
+				on_block_stored(abs_block_idx_to_sect_blk(block_idx).first, block_idx);
+			}
+
+			void files_accept_session::file_receive_task::do_write_run(write_run run){
+				m_worker.execute_in_file_thread([run = std::move(run), this_task = shared_from_this()]() mutable {
+					const auto length = run.length;
+					if (not this_task->m_writer) {
+						this_task->m_worker.pending_writes().release(length);
+						return;
+					}
+					this_task->m_writer->submit(std::move(run), [this_task, length](bool written) {
+						if (written)
+							this_task->m_worker.on_disk_write();
+						this_task->m_worker.pending_writes().release(length);
+					});
+				});
+			}
+
 			void files_accept_session::file_receive_task::do_report_file_info_ack(){
 				const auto msg_length = sizeof(message::protocol_header) + sizeof(message::file_info_ack);
 				auto msg = make_message_blob(msg_length);
@@ -443,7 +697,7 @@ namespace ya_uftp {
 			
 			void files_accept_session::file_receive_task::do_report_status(message::section_index sect_idx) {
 				const auto msg_length = sizeof(message::protocol_header) + sizeof(message::status) + m_context.block_size;
-				auto msg = make_message_blob(msg_length);
+				auto msg = m_worker.packet_pool().make(msg_length, 0u);
 				auto uftp_hdr = new (msg->data()) message::protocol_header;
 				m_worker.setup_header(*uftp_hdr, message::role::status);
 				auto status_hdr = new (msg->data() + sizeof(message::protocol_header)) message::status;
@@ -453,8 +707,7 @@ namespace ya_uftp {
 
 				status_hdr->make_transfer_ready();
 				auto [success, bytes_sent] = m_worker.send_packet(msg, [this, sect_idx](auto buf) {
-					to_block_range(m_blocks_per_section_completion_record[sect_idx].missing_blocks, buf.data());
-					return m_blocks_per_section_completion_record[sect_idx].missing_blocks.num_blocks();
+					return m_missing_blocks.extract(sect_blk_to_abs_block_idx(sect_idx, 0u), section_block_count(sect_idx), buf.data());
 				});
 			}
 		}
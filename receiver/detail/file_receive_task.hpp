@@ -4,9 +4,12 @@
 
 #include "detail/file_transfer_base.hpp"
 #include "receiver/detail/session_context.hpp"
-#include <fstream>
+#include "receiver/detail/write_behind.hpp"
+#include "detail/block_bitmap.hpp"
+#include "detail/fec.hpp"
+#include <array>
+#include <map>
 #include <mutex>
-#include "boost/dynamic_bitset.hpp"
 
 namespace ya_uftp {
 	namespace receiver {
@@ -16,6 +19,23 @@ namespace ya_uftp {
 				public ya_uftp::detail::file_transfer_base,
 				public worker::employer {
 				struct private_ctor_tag {};
+				// a block kept where it was received, nullptr owner when it is in the mapped file
+				struct kept_block {
+					message_blob									owner;
+					api::blob_view									payload;
+				};
+				// a group of blocks the parity is for, the data blocks received of it are kept
+				// until its parity rebuilds those lost. they are copied out only to be decoded
+				struct parity_group {
+					std::size_t										size = 0u;
+					// a slot per data block then per parity block received
+					std::vector<kept_block>							blocks;
+					std::array<bool, ya_uftp::detail::fec_codec::max_symbols>	received = {};
+					std::size_t										data_received = 0u;
+					// the row of each parity block received, in the order of their slots
+					std::vector<std::uint8_t>						parity_rows;
+				};
+				using parity_groups = std::map<std::uintmax_t, parity_group>;
 
 				enum class phase : std::uint8_t {
 					waiting_file_info,
@@ -26,17 +46,19 @@ namespace ya_uftp {
 					learn_session_completed
 				};
 
-				struct received_record {
-					boost::dynamic_bitset<std::uint8_t>	missing_blocks;
-					std::uint32_t						count;
-				};
-
 				worker& m_worker;
 				session_context& m_context;
 
 				message::file_id_type							m_file_id = 0u;
 				std::uintmax_t									m_current_block_idx = 0u;
-				std::ofstream									m_file_stream;
+				// opened in the net thread, then only touched in the file thread
+				std::unique_ptr<block_writer>					m_writer;
+				api::optional<write_behind>						m_write_behind;
+				// instead of the writer, when the blocks are received into their place
+				std::unique_ptr<mapped_destination>				m_mapped;
+				// the block next to the last received, and the one the last placement was predicted for
+				std::uintmax_t									m_next_block = 0u;
+				std::uintmax_t									m_predicted_block = 0u;
 				
 				api::fs::path									m_file_path;
 				api::fs::path									m_final_dest_path;
@@ -45,8 +67,17 @@ namespace ya_uftp {
 				std::uint32_t									m_last_fileinfo_ts_high;
 				std::uint32_t									m_last_fileinfo_ts_low;
                 std::uint64_t									m_file_ts = 0u;
-				boost::dynamic_bitset<>							m_completed_sections;
-				std::map<std::uint16_t, received_record>		m_blocks_per_section_completion_record;
+				// one bit per block of the file, set while the block is missing
+				ya_uftp::detail::block_bitmap					m_missing_blocks;
+				// blocks received per section, the section is complete once all of its blocks are
+				std::vector<message::block_index>				m_received_per_section;
+				message::section_index							m_completed_section_count = 0u;
+				// the group being received and those left behind lacking blocks, by their first block
+				parity_groups									m_parity_groups;
+				// the group being received, those before its end are all opened already
+				std::uintmax_t									m_parity_first = 0u;
+				std::uintmax_t									m_parity_end = 0u;
+				std::size_t										m_parity_bytes = 0u;
 			public:
 				file_receive_task(
 					std::shared_ptr<files_accept_session> parent,
@@ -58,14 +89,34 @@ namespace ya_uftp {
 				void run(message_blob next_file_info = nullptr);
 			private:
                 std::uint32_t id() const;
-				std::uint8_t on_message_received(message::validated_packet valid_packet) override;
+				std::uint8_t on_message_received(message::validated_packet valid_packet, const message_blob& packet_buffer) override;
 				void on_file_info_received(api::blob_span packet, message::member_id source_id);
-				void on_data_block_received(api::blob_span packet, message::member_id source_id);
+				void on_data_block_received(api::blob_span packet, message::member_id source_id, const message_blob& packet_buffer);
+				api::optional<placement> predict_placement() override;
+				std::uint8_t on_block_placed(message::validated_packet valid_packet, api::blob_span payload) override;
+				// the length of the block, which is the block size but for the last block
+				std::size_t block_length(std::uintmax_t block_idx) const;
+				void on_block_stored(message::section_index sect_idx, std::uintmax_t block_idx);
+				bool section_complete(message::section_index sect_idx);
 				void on_done_received(api::blob_span packet, message::member_id source_id);
+				// start keeping the group the block is in
+				parity_groups::iterator open_parity_group(std::uintmax_t block_idx);
+				// the group kept the block is in, end() when it is not
+				parity_groups::iterator find_parity_group(std::uintmax_t block_idx);
+				void close_parity_group(parity_groups::iterator group);
+				// keep a block received for the parity of its group, if the sender codes any
+				void keep_for_parity(std::uintmax_t block_idx, api::blob_view payload, const message_blob& owner);
+				void on_parity_received(api::blob_span packet, const message_blob& packet_buffer);
+				// store a block the parity rebuilt as if it was received
+				void store_rebuilt_block(std::uintmax_t block_idx, const std::uint8_t* data);
 				
+				// hand the run to the file thread, the receive buffers are released once it is written
+				void do_write_run(write_run run);
 				void do_report_file_info_ack();
 				void do_report_complete();
 				void do_report_status(message::section_index sect_idx);
+				// a STATUS for each section not complete among the count sections ending at last_sect_idx
+				void report_sections_status(message::section_index last_sect_idx, std::uint32_t count);
 			};
 		}
 	}
@@ -1,11 +1,13 @@
 #include "receiver/detail/files_accept_session.hpp"
 #include "receiver/detail/file_receive_task.hpp"
+#include "detail/fec.hpp"
 //#include "boost/endian/conversion.hpp"
 
 namespace ya_uftp{
 	namespace receiver{
 		namespace detail{
 			files_accept_session::files_accept_session(
+				std::shared_ptr<port_listener> listener,
 				boost::asio::io_context& net_io_ctx,
 				boost::asio::io_context& file_io_ctx,
 				boost::asio::ip::address private_mcast_addr,
@@ -15,17 +17,23 @@ namespace ya_uftp{
 				message::member_id	sender_id,
 				const std::uint32_t& announce_ts_high,
 				const std::uint32_t& announce_ts_low,
+				const api::optional<message::extension::fec_info>& fec,
 				task::parameters& params,
 				private_ctor_tag tag) :
-				m_worker(std::make_unique<worker>(net_io_ctx, file_io_ctx, 
+				m_worker(std::make_unique<worker>(std::move(listener), net_io_ctx, file_io_ctx, 
 					private_mcast_addr, sender_ep, 
 					open_group, session_id, sender_id, blk_size, robust, params)),
 				m_context(m_worker->get_context()),
 				m_last_announce_ts_high(announce_ts_high),
-				m_last_announce_ts_low(announce_ts_low){}
+				m_last_announce_ts_low(announce_ts_low){
+				if (fec and params.accept_fec and 
+					ya_uftp::detail::fec_codec::valid(fec->data_blocks, fec->parity_blocks))
+					m_context.fec.emplace(*fec);
+			}
 
 			std::shared_ptr<files_accept_session>
-				files_accept_session::create(boost::asio::io_context& net_io_ctx,
+				files_accept_session::create(std::shared_ptr<port_listener> listener,
+					boost::asio::io_context& net_io_ctx,
 					boost::asio::io_context& file_io_ctx,
 					boost::asio::ip::address private_mcast_addr,
 					boost::asio::ip::udp::endpoint	sender_ep,
@@ -34,10 +42,11 @@ namespace ya_uftp{
 					message::member_id	sender_id,
 					const std::uint32_t& announce_ts_high,
 					const std::uint32_t& announce_ts_low,
+					const api::optional<message::extension::fec_info>& fec,
 					task::parameters& params) {
-				return std::make_shared<files_accept_session>(net_io_ctx, file_io_ctx, private_mcast_addr,
+				return std::make_shared<files_accept_session>(std::move(listener), net_io_ctx, file_io_ctx, private_mcast_addr,
 					sender_ep, open_group, blk_size, robust, session_id, sender_id,
-					announce_ts_high, announce_ts_low, params, private_ctor_tag{});
+					announce_ts_high, announce_ts_low, fec, params, private_ctor_tag{});
 			}
 
 			void files_accept_session::start() {
@@ -50,7 +59,8 @@ namespace ya_uftp{
 				m_worker->cancel_all_jobs();
 			}
 
-			std::uint8_t files_accept_session::on_message_received(message::validated_packet valid_packet) {
+			std::uint8_t files_accept_session::on_message_received(message::validated_packet valid_packet, 
+				const message_blob& packet_buffer) {
 				auto grtt_factor = std::uint8_t(3);
 				switch (valid_packet.msg_header.message_role) {
 				case message::role::reg_conf:
@@ -99,7 +109,8 @@ namespace ya_uftp{
 				auto msg = message_blob{};
 				
 				if (not m_context.encryption_enabled) {
-					const auto msg_length = sizeof(message::protocol_header) + sizeof(message::receiver_register);
+					const auto ext_length = m_context.fec ? sizeof(message::extension::fec_info) : 0u;
+					const auto msg_length = sizeof(message::protocol_header) + sizeof(message::receiver_register) + ext_length;
 					msg = make_message_blob(msg_length);
 
 					auto uftp_hdr = new (msg->data()) message::protocol_header;
@@ -111,6 +122,14 @@ namespace ya_uftp{
 					register_hdr->msg_timestamp_usecs_high = m_last_announce_ts_high;
 					register_hdr->msg_timestamp_usecs_low = m_last_announce_ts_low;
 					register_hdr->make_transfer_ready();
+					if (m_context.fec){
+						// the offer echoed, the sender codes the parity once a receiver takes it
+						auto fec_ext = new (msg->data() + sizeof(message::protocol_header) + sizeof(message::receiver_register))
+							message::extension::fec_info;
+						fec_ext->length = sizeof(message::extension::fec_info) / message::header_length_unit;
+						fec_ext->data_blocks = m_context.fec->data_blocks;
+						fec_ext->parity_blocks = m_context.fec->parity_blocks;
+					}
 				}
 				else {
 				}
@@ -28,6 +28,7 @@ namespace ya_uftp{
 				};
 
 				files_accept_session(
+					std::shared_ptr<port_listener> listener,
 					boost::asio::io_context& net_io_ctx,
 					boost::asio::io_context& file_io_ctx,
 					boost::asio::ip::address private_mcast_addr,
@@ -37,11 +38,13 @@ namespace ya_uftp{
 					message::member_id	sender_id,
 					const std::uint32_t& announce_ts_high,
 					const std::uint32_t& announce_ts_low,
+					const api::optional<message::extension::fec_info>& fec,
 					task::parameters& params,
 					private_ctor_tag tag);
 					
 				static std::shared_ptr<files_accept_session>
-					create(boost::asio::io_context& net_io_ctx, 
+					create(std::shared_ptr<port_listener> listener, 
+						boost::asio::io_context& net_io_ctx,
 						boost::asio::io_context& file_io_ctx,
 						boost::asio::ip::address private_mcast_addr,
 						boost::asio::ip::udp::endpoint	sender_ep,
@@ -50,11 +53,12 @@ namespace ya_uftp{
 						message::member_id	sender_id,
 						const std::uint32_t& announce_ts_high,
 						const std::uint32_t& announce_ts_low,
+						const api::optional<message::extension::fec_info>& fec,
 						task::parameters& params);
 				
 				void start();
 				void stop();
-				std::uint8_t on_message_received(message::validated_packet valid_packet) override;
+				std::uint8_t on_message_received(message::validated_packet valid_packet, const message_blob& packet_buffer) override;
 				
 				void on_file_receive_complete(visa v, 
 					message_blob next_file_info = nullptr);
@@ -0,0 +1,563 @@
+#include "receiver/detail/port_listener.hpp"
+#include "receiver/detail/worker.hpp"
+
+#include "utilities/network_intf.hpp"
+#include <array>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <errno.h>
+#include <cstring>
+#ifdef UDP_GRO
+#define YA_UFTP_HAS_UDP_GRO 1
+#endif
+#endif
+
+namespace ya_uftp{
+	namespace receiver{
+		namespace detail{
+			namespace{
+				struct listener_registry {
+					std::mutex	mutex;
+					std::map<std::pair<std::uint16_t, bool>, std::weak_ptr<port_listener>>	listeners;
+				};
+
+				listener_registry& registry(){
+					static auto the_registry = listener_registry{};
+					return the_registry;
+				}
+
+				void change_membership(boost::asio::ip::udp::socket& socket, const boost::asio::ip::address& group, bool join){
+					auto ec = boost::system::error_code{};
+					auto& active_interfaces = jcy::network::interface::retrieve_all();
+					for (auto& intf_info : active_interfaces){
+						if (intf_info.is_loopback())
+							continue;
+						for (auto& interface_addr : intf_info.unicast_addresses()){
+							if (group.is_v4() and interface_addr.is_v4() and not interface_addr.is_loopback()){
+								if (join)
+									socket.set_option(boost::asio::ip::multicast::join_group(group.to_v4(), interface_addr.to_v4()), ec);
+								else
+									socket.set_option(boost::asio::ip::multicast::leave_group(group.to_v4(), interface_addr.to_v4()), ec);
+							}
+							else if (group.is_v6() and interface_addr.is_v6() and not interface_addr.is_loopback()){
+								if (join)
+									socket.set_option(boost::asio::ip::multicast::join_group(group.to_v6(), intf_info.index()), ec);
+								else
+									socket.set_option(boost::asio::ip::multicast::leave_group(group.to_v6(), intf_info.index()), ec);
+							}
+							// ToDo: part of proper logging, the groups are joined on the interfaces which can
+						}
+					}
+				}
+			}
+
+#ifdef __linux__
+			namespace{
+				// learn the drop counter, return the segment size of a coalesced read or 0
+				std::size_t read_control(::msghdr& hdr, std::atomic<std::uint64_t>& kernel_drops){
+					auto segment_size = std::size_t(0u);
+					for (auto cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)){
+						if (cmsg->cmsg_level == SOL_SOCKET and cmsg->cmsg_type == SO_RXQ_OVFL){
+							auto drops = std::uint32_t{};
+							std::memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+							// the counter covers the whole life of the socket
+							kernel_drops.store(drops, std::memory_order_relaxed);
+						}
+#ifdef YA_UFTP_HAS_UDP_GRO
+						else if (cmsg->cmsg_level == SOL_UDP and cmsg->cmsg_type == UDP_GRO){
+							auto gro_size = 0;
+							std::memcpy(&gro_size, CMSG_DATA(cmsg), sizeof(gro_size));
+							segment_size = gro_size > 0 ? static_cast<std::size_t>(gro_size) : 0u;
+						}
+#endif
+					}
+					return segment_size;
+				}
+
+				boost::asio::ip::udp::endpoint to_endpoint(const ::sockaddr_storage& name, ::socklen_t length){
+					auto ep = boost::asio::ip::udp::endpoint{};
+					const auto size = std::min<std::size_t>(length, ep.capacity());
+					std::memcpy(ep.data(), &name, size);
+					ep.resize(size);
+					return ep;
+				}
+			}
+
+			struct port_listener::receive_batch {
+				static constexpr std::size_t	placed_header_size = sizeof(message::protocol_header) + sizeof(message::file_seg);
+				// the drop counter and the segment size of a coalesced read
+				struct alignas(::cmsghdr) read_control {
+					char buf[CMSG_SPACE(sizeof(std::uint32_t)) + CMSG_SPACE(sizeof(int))];
+				};
+				std::vector<message_blob>		buffers;
+				std::vector<::mmsghdr>			headers;
+				std::vector<::iovec>			iovs;
+				std::vector<read_control>		controls;
+				// the senders, the monitors answer the announcements there
+				std::vector<::sockaddr_storage>	names;
+				// the headers of a datagram whose payload is read into the place predicted
+				alignas(std::uint64_t) std::array<std::uint8_t, placed_header_size>	placed_header;
+
+				receive_batch(ya_uftp::detail::packet_pool& ring, std::size_t count) :
+					buffers(count), headers(count), iovs(count), controls(count), names(count){
+					for (auto i = 0u; i < count; i++){
+						std::memset(&headers[i], 0, sizeof(::mmsghdr));
+						headers[i].msg_hdr.msg_iov = &iovs[i];
+						headers[i].msg_hdr.msg_iovlen = 1;
+						headers[i].msg_hdr.msg_control = controls[i].buf;
+						headers[i].msg_hdr.msg_name = &names[i];
+						refill(ring, i);
+					}
+				}
+				void refill(ya_uftp::detail::packet_pool& ring, std::size_t slot){
+					buffers[slot] = ring.make(ring.buffer_capacity());
+					iovs[slot].iov_base = buffers[slot]->data();
+					iovs[slot].iov_len = buffers[slot]->size();
+				}
+			};
+#else
+			struct port_listener::receive_batch {};
+#endif
+
+			port_listener::port_listener(boost::asio::io_context& net_io_ctx, const task::parameters& params, private_ctor_tag tag) :
+				m_net_io_ctx(net_io_ctx), m_socket(net_io_ctx),
+				m_v4(params.public_multicast_addr.is_v4()), m_port(params.listen_port),
+				m_ring_size(params.receive_ring_size), m_hugepages(params.packet_pool_hugepages),
+				m_udp_buffer_size(params.udp_buffer_size), m_gro_wanted(params.enable_udp_gro),
+				m_wanted_buffer_size(1500u), m_batch_size(params.receive_batch_size){
+				auto ec = boost::system::error_code{};
+				if (m_v4)
+					m_socket.open(boost::asio::ip::udp::v4(), ec);
+				else
+					m_socket.open(boost::asio::ip::udp::v6(), ec);
+				if (ec){
+					std::cout << "Failed to open udp socket\n";
+					return;
+				}
+				m_socket.set_option(boost::asio::socket_base::reuse_address(true), ec);
+				m_socket.set_option(boost::asio::socket_base::receive_buffer_size(params.udp_buffer_size), ec);
+				if (m_v4)
+					m_socket.bind(boost::asio::ip::udp::endpoint{ boost::asio::ip::address_v4::any(), m_port }, ec);
+				else
+					m_socket.bind(boost::asio::ip::udp::endpoint{ boost::asio::ip::address_v6::any(), m_port }, ec);
+				if (ec)
+					std::cout << "Failed to bind to port " << m_port << ". \nReason: " << ec.message() << '\n';
+
+				auto receive_buffer_size = m_wanted_buffer_size.load();
+				auto batched = false;
+#ifdef __linux__
+				if (m_batch_size > 1u){
+					m_socket.non_blocking(true, ec);
+					batched = not ec;
+					// the kernel attaches the count of the datagrams dropped so far to each one read
+					auto enable = 1;
+					if (batched)
+						::setsockopt(m_socket.native_handle(), SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+#ifdef YA_UFTP_HAS_UDP_GRO
+					// the kernel may then hand consecutive datagrams of the sender over as one read
+					if (batched and params.enable_udp_gro and
+						::setsockopt(m_socket.native_handle(), SOL_UDP, UDP_GRO, &enable, sizeof(enable)) == 0){
+						receive_buffer_size = m_max_coalesced_read;
+						m_coalescing = true;
+					}
+#endif
+				}
+#endif
+				// the batch slots always hold a buffer each, leave the rest to the blocks waiting for the disk
+				m_receive_ring = std::make_unique<ya_uftp::detail::packet_pool>(receive_buffer_size,
+					std::max<std::size_t>(m_ring_size / receive_buffer_size, batched ? m_batch_size * 2 : 16u), m_hugepages);
+				if (batched)
+					m_receive_batch = std::make_unique<receive_batch>(*m_receive_ring, m_batch_size);
+			}
+
+			port_listener::~port_listener() = default;
+
+			std::shared_ptr<port_listener> port_listener::open(boost::asio::io_context& net_io_ctx, const task::parameters& params){
+				auto& the_registry = registry();
+				auto lock = std::lock_guard{ the_registry.mutex };
+				auto& known = the_registry.listeners[{ params.listen_port, params.public_multicast_addr.is_v4() }];
+				auto listener = known.lock();
+				if (not listener){
+					listener = std::make_shared<port_listener>(net_io_ctx, params, private_ctor_tag{});
+					known = listener;
+				}
+				else
+					listener->report_ignored(params);
+				return listener;
+			}
+
+			void port_listener::report_ignored(const task::parameters& params) const{
+				auto report = [this](const char* option, auto kept, auto ignored){
+					if (kept != ignored)
+						std::cout << "The socket of port " << m_port << " is shared, " << option << " stays " << kept
+							<< ", " << ignored << " is ignored\n";
+				};
+				report("receive_batch_size", m_batch_size, params.receive_batch_size);
+				report("enable_udp_gro", m_gro_wanted, params.enable_udp_gro);
+				report("udp_buffer_size", m_udp_buffer_size, params.udp_buffer_size);
+				report("receive_ring_size", m_ring_size, params.receive_ring_size);
+			}
+
+			boost::asio::io_context& port_listener::context(){
+				return m_net_io_ctx;
+			}
+
+			boost::asio::ip::udp::socket& port_listener::socket(){
+				return m_socket;
+			}
+
+			void port_listener::join(const boost::asio::ip::address& group){
+				auto lock = std::lock_guard{ m_mutex };
+				if (m_groups[group]++ == 0u)
+					change_membership(m_socket, group, true);
+			}
+
+			void port_listener::leave(const boost::asio::ip::address& group){
+				auto lock = std::lock_guard{ m_mutex };
+				auto it = m_groups.find(group);
+				if (it == m_groups.end() or --it->second > 0u)
+					return;
+				m_groups.erase(it);
+				change_membership(m_socket, group, false);
+			}
+
+			std::uint32_t port_listener::subscribe_announcements(announcement_handler handler){
+				auto id = std::uint32_t{};
+				{
+					auto lock = std::lock_guard{ m_mutex };
+					id = m_next_handler_id++;
+					m_announcement_handlers.emplace(id, std::move(handler));
+				}
+				boost::asio::post(m_net_io_ctx, [this_listener = shared_from_this()](){
+					this_listener->listen();
+				});
+				return id;
+			}
+
+			void port_listener::unsubscribe_announcements(std::uint32_t id){
+				{
+					auto lock = std::lock_guard{ m_mutex };
+					m_announcement_handlers.erase(id);
+				}
+				release_if_idle();
+			}
+
+			void port_listener::route(std::uint32_t sender_id, std::uint32_t session_id, worker& w,
+				std::shared_ptr<void> keeper, std::weak_ptr<void> boss){
+				auto replaced = std::shared_ptr<void>{};
+				{
+					auto lock = std::lock_guard{ m_mutex };
+					auto& entry = m_routes[route_key(sender_id, session_id)];
+					replaced = std::move(entry.keeper);
+					entry = route_entry{ &w, std::move(keeper), std::move(boss) };
+				}
+				// the employer replaced may be the last owner of the session, never destroy it under the caller
+				boost::asio::post(m_net_io_ctx, [this_listener = shared_from_this(), replaced = std::move(replaced)](){
+					this_listener->listen();
+				});
+			}
+
+			void port_listener::unroute(std::uint32_t sender_id, std::uint32_t session_id, const worker& w){
+				auto removed = std::shared_ptr<void>{};
+				{
+					auto lock = std::lock_guard{ m_mutex };
+					auto it = m_routes.find(route_key(sender_id, session_id));
+					if (it == m_routes.end() or it->second.target != &w)
+						return;
+					removed = std::move(it->second.keeper);
+					m_routes.erase(it);
+				}
+				if (removed)
+					boost::asio::post(m_net_io_ctx, [removed = std::move(removed)](){});
+				release_if_idle();
+			}
+
+			void port_listener::fit_datagrams(std::size_t size){
+				auto wanted = m_wanted_buffer_size.load();
+				while (size > wanted and not m_wanted_buffer_size.compare_exchange_weak(wanted, size)){}
+				// the slots may be in the middle of a batch, renew them once it is done
+				if (size > wanted)
+					boost::asio::post(m_net_io_ctx, [this_listener = shared_from_this()](){
+						this_listener->renew_ring();
+					});
+			}
+
+			std::uint64_t port_listener::receive_syscalls() const{
+				return m_receive_syscalls.load(std::memory_order_relaxed);
+			}
+
+			std::uint64_t port_listener::kernel_drops() const{
+				return m_kernel_drops.load(std::memory_order_relaxed);
+			}
+
+			std::uint64_t port_listener::coalesced_datagrams() const{
+				return m_coalesced_datagrams.load(std::memory_order_relaxed);
+			}
+
+			std::uint64_t port_listener::receive_ring_buffers() const{
+				auto lock = std::lock_guard{ m_mutex };
+				return m_receive_ring->buffers_count();
+			}
+
+			std::uint64_t port_listener::receive_ring_misses() const{
+				auto lock = std::lock_guard{ m_mutex };
+				return m_retired_ring_misses + m_receive_ring->misses();
+			}
+
+			bool port_listener::idle() const{
+				auto lock = std::lock_guard{ m_mutex };
+				return m_routes.empty() and m_announcement_handlers.empty();
+			}
+
+			port_listener::routed port_listener::find_route(std::uint64_t key) const{
+				auto found = routed{};
+				auto lock = std::lock_guard{ m_mutex };
+				if (auto it = m_routes.find(key); it != m_routes.end()){
+					found.keeper = it->second.keeper ? it->second.keeper : it->second.boss.lock();
+					if (found.keeper)
+						found.target = it->second.target;
+				}
+				return found;
+			}
+
+			void port_listener::listen(){
+				if (m_reading or not m_socket.is_open())
+					return;
+				m_reading = true;
+				loop_read();
+			}
+
+			void port_listener::release_if_idle(){
+				boost::asio::post(m_net_io_ctx, [this_listener = shared_from_this()](){
+					if (this_listener->m_reading and this_listener->idle()){
+						auto ec = boost::system::error_code{};
+						this_listener->m_socket.cancel(ec);
+					}
+				});
+			}
+
+			void port_listener::renew_ring(){
+				const auto buffer_size = m_wanted_buffer_size.load();
+				if (m_coalescing or buffer_size <= m_receive_ring->buffer_capacity())
+					return;
+				// the buffers out of the old ring stay valid with the workers until they drop them
+				auto ring = std::make_unique<ya_uftp::detail::packet_pool>(buffer_size,
+					std::max<std::size_t>(m_ring_size / buffer_size, m_receive_batch ? m_batch_size * 2 : 16u), m_hugepages);
+				{
+					auto lock = std::lock_guard{ m_mutex };
+					m_retired_ring_misses += m_receive_ring->misses();
+					std::swap(m_receive_ring, ring);
+				}
+#ifdef __linux__
+				if (m_receive_batch){
+					for (auto i = std::size_t(0u); i < m_batch_size; i++)
+						m_receive_batch->refill(*m_receive_ring, i);
+				}
+#endif
+			}
+
+			void port_listener::loop_read(){
+				if (m_receive_batch){
+					m_socket.async_wait(boost::asio::ip::udp::socket::wait_read,
+						[this_listener = shared_from_this()](const boost::system::error_code ec){
+						if (not ec){
+							auto read_ec = this_listener->read_batch();
+							if (read_ec and read_ec != boost::asio::error::would_block and
+								read_ec != boost::asio::error::try_again)
+								std::cout << "received packet but not quite right\n";
+						}
+						else if (ec != boost::asio::error::operation_aborted)
+							std::cout << "received packet but not quite right\n";
+						if (this_listener->idle()){
+							this_listener->m_reading = false;
+							return;
+						}
+						this_listener->loop_read();
+					});
+					return;
+				}
+
+				auto buf = m_receive_ring->make(m_receive_ring->buffer_capacity());
+				m_socket.async_receive_from(boost::asio::buffer(buf->data(), buf->size()), m_source_ep,
+					[this_listener = shared_from_this(), buf](const boost::system::error_code ec, std::size_t bytes_read){
+					if (not ec){
+						this_listener->m_receive_syscalls.fetch_add(1u, std::memory_order_relaxed);
+						this_listener->dispatch(buf, api::blob_span{ buf->data(), static_cast<api::blob_span::size_type>(bytes_read) },
+							this_listener->m_source_ep);
+					}
+					else if (ec != boost::asio::error::operation_aborted)
+						std::cout << "received packet but not quite right\n";
+					if (this_listener->idle()){
+						this_listener->m_reading = false;
+						return;
+					}
+					this_listener->loop_read();
+				});
+			}
+
+			void port_listener::dispatch(const message_blob& buffer, api::blob_span packet,
+				const boost::asio::ip::udp::endpoint& from){
+				auto validated_packet = message::basic_validate_packet(packet);
+				if (not validated_packet)
+					return;
+				auto& msg_header = validated_packet->msg_header;
+				if (msg_header.message_role == message::role::announce){
+					// the handlers may start sessions, which route themselves
+					auto handlers = std::vector<announcement_handler>{};
+					{
+						auto lock = std::lock_guard{ m_mutex };
+						for (auto& [id, handler] : m_announcement_handlers)
+							handlers.emplace_back(handler);
+					}
+					// the monitors parse the announcement in place, each of them takes a copy of its own
+					for (auto& handler : handlers){
+						auto copy = make_message_blob(packet.begin(), packet.end());
+						if (auto copied_packet = message::basic_validate_packet(
+							api::blob_span{ copy->data(), static_cast<api::blob_span::size_type>(copy->size()) }); copied_packet)
+							handler(copied_packet.value(), from);
+					}
+				}
+				const auto key = route_key(msg_header.source_id, msg_header.session_id);
+				if (auto r = find_route(key); r.target){
+					if (msg_header.message_role == message::role::file_seg)
+						m_recent_route = key;
+					if (&r.target->m_net_io_ctx == &m_net_io_ctx){
+						r.target->deliver(validated_packet.value(), buffer);
+						return;
+					}
+					// the buffer holds the packet and the keeper the worker until it runs in its own thread
+					boost::asio::post(r.target->m_net_io_ctx, [r = std::move(r), packet = validated_packet.value(), buffer](){
+						r.target->deliver(packet, buffer);
+					});
+				}
+			}
+
+#ifdef __linux__
+			boost::system::error_code port_listener::read_batch(){
+				// a coalesced read would spill the datagrams after the first one over the place predicted
+				if (not m_coalescing and m_recent_route){
+					const auto key = m_recent_route.value();
+					// only a worker running in this thread can predict where its next block goes
+					if (auto r = find_route(key); r.target and &r.target->m_net_io_ctx == &m_net_io_ctx){
+						// the spare buffer takes the whole datagram when it is not the block, not before the ring fits the blocks
+						if (auto where = r.target->predict_placement(); where and
+							receive_batch::placed_header_size + where->length <= m_receive_batch->buffers[0]->size())
+							return read_placed(key, r, api::blob_span{ where->data, static_cast<api::blob_span::size_type>(where->length) });
+					}
+				}
+				auto& batch = *m_receive_batch;
+				for (auto& hdr : batch.headers){
+					hdr.msg_hdr.msg_controllen = sizeof(receive_batch::read_control);
+					hdr.msg_hdr.msg_namelen = sizeof(::sockaddr_storage);
+					hdr.msg_hdr.msg_flags = 0;
+				}
+				auto count = ::recvmmsg(m_socket.native_handle(), batch.headers.data(),
+					static_cast<unsigned int>(batch.headers.size()), MSG_DONTWAIT, nullptr);
+				if (count < 0)
+					return boost::system::error_code{errno, boost::system::system_category()};
+				m_receive_syscalls.fetch_add(1u, std::memory_order_relaxed);
+
+				for (auto i = 0; i < count; i++){
+					auto& hdr = batch.headers[i].msg_hdr;
+					auto segment_size = read_control(hdr, m_kernel_drops);
+					// no valid datagram is larger than the buffer
+					if (hdr.msg_flags & MSG_TRUNC)
+						continue;
+					const auto from = to_endpoint(batch.names[i], hdr.msg_namelen);
+					// a coalesced read is the datagrams back to back, all of the segment size but the last one
+					auto data = batch.buffers[i]->data();
+					auto left = static_cast<std::size_t>(batch.headers[i].msg_len);
+					if (segment_size == 0u)
+						segment_size = left;
+					else if (left > segment_size)
+						m_coalesced_datagrams.fetch_add((left + segment_size - 1) / segment_size, std::memory_order_relaxed);
+					while (left > 0u){
+						const auto length = std::min(segment_size, left);
+						dispatch(batch.buffers[i], api::blob_span{ data, static_cast<api::blob_span::size_type>(length) }, from);
+						data += length;
+						left -= length;
+					}
+				}
+				// the slots whose buffer a worker kept, e.g. for the disk writer, take a fresh one
+				for (auto i = 0; i < count; i++){
+					if (not batch.buffers[i].unique())
+						batch.refill(*m_receive_ring, i);
+				}
+				return boost::system::error_code{};
+			}
+
+			boost::system::error_code port_listener::read_placed(std::uint64_t key, const routed& r, api::blob_span where){
+				constexpr auto header_size = receive_batch::placed_header_size;
+				auto& batch = *m_receive_batch;
+				// the first slot of the batch is the spare buffer, it takes the tail of what is not the block
+				// predicted and then the whole datagram to be dispatched as usual
+				auto& spare = batch.buffers[0];
+				for (auto reads = std::size_t(0u); reads < batch.headers.size(); reads++){
+					::iovec iovs[3] = {
+						{ batch.placed_header.data(), header_size },
+						{ where.data(), where.size() },
+						{ spare->data() + header_size + where.size(), spare->size() - header_size - where.size() },
+					};
+					auto hdr = ::msghdr{};
+					hdr.msg_iov = iovs;
+					hdr.msg_iovlen = 3;
+					hdr.msg_control = batch.controls[0].buf;
+					hdr.msg_controllen = sizeof(receive_batch::read_control);
+					hdr.msg_name = &batch.names[0];
+					hdr.msg_namelen = sizeof(::sockaddr_storage);
+					auto bytes_read = ::recvmsg(m_socket.native_handle(), &hdr, MSG_DONTWAIT);
+					if (bytes_read < 0)
+						return boost::system::error_code{errno, boost::system::system_category()};
+					m_receive_syscalls.fetch_add(1u, std::memory_order_relaxed);
+					read_control(hdr, m_kernel_drops);
+
+					const auto length = static_cast<std::size_t>(bytes_read);
+					auto uftp_hdr = reinterpret_cast<const message::protocol_header*>(batch.placed_header.data());
+					auto fseg_hdr = reinterpret_cast<const message::file_seg*>(batch.placed_header.data() + sizeof(message::protocol_header));
+					// no valid datagram is larger than the buffer
+					if (hdr.msg_flags & MSG_TRUNC)
+						continue;
+					if (length >= header_size and length <= header_size + where.size() and
+						fseg_hdr->the_role == message::role::file_seg and
+						fseg_hdr->header_length * message::header_length_unit == sizeof(message::file_seg) and
+						route_key(uftp_hdr->source_id, uftp_hdr->session_id) == key){
+						auto headers = api::blob_span{ batch.placed_header.data(), static_cast<api::blob_span::size_type>(header_size) };
+						if (auto validated_packet = message::basic_validate_packet(headers); validated_packet)
+							r.target->deliver_placed(validated_packet.value(),
+								api::blob_span{ where.data(), static_cast<api::blob_span::size_type>(length - header_size) });
+					}
+					else{
+						// not a block of the session, put the datagram back together in the spare buffer. what spilt over
+						// the place predicted is garbage there, the block is still missing and overwritten when it comes
+						std::memcpy(spare->data(), batch.placed_header.data(), std::min(length, header_size));
+						if (length > header_size)
+							std::memcpy(spare->data() + header_size, where.data(), std::min(length - header_size, where.size()));
+						dispatch(spare, api::blob_span{ spare->data(), static_cast<api::blob_span::size_type>(length) },
+							to_endpoint(batch.names[0], hdr.msg_namelen));
+						if (not spare.unique())
+							batch.refill(*m_receive_ring, 0);
+					}
+
+					auto next = r.target->predict_placement();
+					if (not next)
+						break;
+					where = api::blob_span{ next->data, static_cast<api::blob_span::size_type>(next->length) };
+				}
+				return boost::system::error_code{};
+			}
+#else
+			boost::system::error_code port_listener::read_batch(){
+				return boost::asio::error::operation_not_supported;
+			}
+
+			boost::system::error_code port_listener::read_placed(std::uint64_t key, const routed& r, api::blob_span where){
+				return boost::asio::error::operation_not_supported;
+			}
+#endif
+		}
+	}
+}
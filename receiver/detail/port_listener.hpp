@@ -0,0 +1,136 @@
+#pragma once
+#ifndef YA_UFTP_RECEIVER_DETAIL_PORT_LISTENER_HPP_
+#define YA_UFTP_RECEIVER_DETAIL_PORT_LISTENER_HPP_
+
+#include "receiver/adi.hpp"
+#include "detail/common.hpp"
+#include "detail/message.hpp"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace ya_uftp{
+	namespace receiver{
+		namespace detail{
+			class worker;
+
+			// the one socket of the process bound to a listen port, for an address family. each datagram is read once
+			// and handed to the worker of its (sender_id, session_id) in the worker's own network thread, the announcements
+			// to the monitors too. the workers send through its socket
+			class port_listener :
+				public std::enable_shared_from_this<port_listener>{
+				struct private_ctor_tag{};
+			public:
+				using announcement_handler = std::function<void(const message::validated_packet&,
+					const boost::asio::ip::udp::endpoint&)>;
+
+				port_listener(boost::asio::io_context& net_io_ctx, const task::parameters& params, private_ctor_tag tag);
+				port_listener(const port_listener&) = delete;
+				port_listener& operator=(const port_listener&) = delete;
+				~port_listener();
+				// the listener already bound to the port of params, or a new one running in net_io_ctx.
+				// the socket options and the receive ring are those of the params it is created with, others are reported and ignored
+				static std::shared_ptr<port_listener> open(boost::asio::io_context& net_io_ctx, const task::parameters& params);
+
+				boost::asio::io_context& context();
+				boost::asio::ip::udp::socket& socket();
+
+				// the group is joined on every interface once, and left when the last one leaves it
+				void join(const boost::asio::ip::address& group);
+				void leave(const boost::asio::ip::address& group);
+				// the handler is called for every valid ANNOUNCE, return the id to unsubscribe with
+				std::uint32_t subscribe_announcements(announcement_handler handler);
+				void unsubscribe_announcements(std::uint32_t id);
+				// route the datagrams of the session to w. keeper, when any, is held until the route is removed,
+				// otherwise boss is locked for each datagram. either way w lives as long as they do
+				void route(std::uint32_t sender_id, std::uint32_t session_id, worker& w,
+					std::shared_ptr<void> keeper, std::weak_ptr<void> boss);
+				// remove the route if it still leads to w, the keeper is released later in the network thread
+				void unroute(std::uint32_t sender_id, std::uint32_t session_id, const worker& w);
+				// the receive buffers take datagrams of size bytes from now on
+				void fit_datagrams(std::size_t size);
+
+				std::uint64_t receive_syscalls() const;
+				std::uint64_t kernel_drops() const;
+				std::uint64_t coalesced_datagrams() const;
+				std::uint64_t receive_ring_buffers() const;
+				std::uint64_t receive_ring_misses() const;
+			private:
+				struct route_entry {
+					worker*					target;
+					std::shared_ptr<void>	keeper;
+					std::weak_ptr<void>		boss;
+				};
+				// a worker and what keeps it alive while a datagram is handed to it
+				struct routed {
+					worker*					target = nullptr;
+					std::shared_ptr<void>	keeper;
+				};
+				struct receive_batch;
+
+				static std::uint64_t route_key(std::uint32_t sender_id, std::uint32_t session_id){
+					return (static_cast<std::uint64_t>(sender_id) << 32) | session_id;
+				}
+
+				boost::asio::io_context&		m_net_io_ctx;
+				boost::asio::ip::udp::socket	m_socket;
+				boost::asio::ip::udp::endpoint	m_source_ep;
+				const bool						m_v4;
+				const std::uint16_t				m_port;
+				const std::size_t				m_ring_size;
+				const bool						m_hugepages;
+				const std::size_t				m_udp_buffer_size;
+				const bool						m_gro_wanted;
+				// the largest UDP payload, what a single GRO read can coalesce at most
+				static constexpr std::size_t	m_max_coalesced_read = 65535u;
+				bool							m_coalescing = false;
+				// network thread only
+				bool							m_reading = false;
+				// the buffers every datagram is received into, they return to the ring once the workers drop them.
+				// replaced in the network thread by a ring of larger buffers when a session of larger blocks comes
+				std::unique_ptr<ya_uftp::detail::packet_pool>	m_receive_ring;
+				std::atomic<std::size_t>		m_wanted_buffer_size;
+				// the buffers and headers recvmmsg() drains into, nullptr when the datagrams are read one by one
+				std::unique_ptr<receive_batch>	m_receive_batch;
+				const std::size_t				m_batch_size;
+				// the session of the last block, whose next block is predicted to come next
+				api::optional<std::uint64_t>	m_recent_route;
+
+				mutable std::mutex				m_mutex;
+				std::unordered_map<std::uint64_t, route_entry>	m_routes;
+				std::map<std::uint32_t, announcement_handler>	m_announcement_handlers;
+				std::uint32_t					m_next_handler_id = 0u;
+				std::map<boost::asio::ip::address, std::size_t>	m_groups;
+
+				std::atomic<std::uint64_t>		m_receive_syscalls = 0u;
+				std::atomic<std::uint64_t>		m_kernel_drops = 0u;
+				std::atomic<std::uint64_t>		m_coalesced_datagrams = 0u;
+				// the heap fallbacks of the rings replaced, under m_mutex as the ring itself
+				std::uint64_t					m_retired_ring_misses = 0u;
+
+				bool idle() const;
+				routed find_route(std::uint64_t key) const;
+				// tell which receive options of params differ from those the socket is set up with
+				void report_ignored(const task::parameters& params) const;
+				// start reading unless it is already, network thread only
+				void listen();
+				// stop reading in the network thread once nothing is subscribed
+				void release_if_idle();
+				void loop_read();
+				void renew_ring();
+				// hand a datagram read whole to the monitors and its worker
+				void dispatch(const message_blob& buffer, api::blob_span packet,
+					const boost::asio::ip::udp::endpoint& from);
+				boost::system::error_code read_batch();
+				// read the datagrams one by one, the payload of each into the place its worker predicts
+				boost::system::error_code read_placed(std::uint64_t key, const routed& r, api::blob_span where);
+			};
+		}
+	}
+}
+
+#endif
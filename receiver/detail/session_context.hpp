@@ -2,6 +2,7 @@
 #ifndef YA_UFTP_RECEIVER_DETAIL_SESSION_CONTEXT_HPP_
 #define	YA_UFTP_RECEIVER_DETAIL_SESSION_CONTEXT_HPP_
 
+#include "receiver/adi.hpp"
 #include "boost/asio.hpp"
 #include "detail/message.hpp"
 
@@ -25,7 +26,17 @@ namespace ya_uftp{
 				bool							encryption_enabled = false;
 				//api::optional<std::uint64_t>	transfer_speed;
 				std::uint8_t					retry_count = 0u;
+				// the received blocks are written in runs of about this many bytes
+				std::size_t						write_run_size = 0u;
+				// receive the blocks into the mapped destination file instead of writing them
+				bool							map_destination_file = false;
+				task::write_backend				file_write_backend = task::write_backend::buffered;
+				bool							preallocate_files = false;
+				bool							drop_written_pages = false;
 				bool							register_confirmed = false;
+				// the parity the sender offered and we accepted, echoed in the REGISTER
+				api::optional<message::extension::fec_info>	fec;
+				std::size_t						parity_memory = 0u;
 				std::vector<api::fs::path>					destination_dirs;
 				api::optional<std::vector<api::fs::path>>	temp_dirs;
 				
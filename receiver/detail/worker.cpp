@@ -1,4 +1,6 @@
 #include "receiver/detail/worker.hpp"
+#include "receiver/detail/write_ring.hpp"
+#include "receiver/detail/port_listener.hpp"
 
 #include "boost/endian/conversion.hpp"
 
@@ -7,7 +9,16 @@ namespace ya_uftp {
 		namespace detail {
 			worker::employer::~employer() = default;
 
-			worker::worker(boost::asio::io_context& net_io_ctx,
+			api::optional<worker::employer::placement> worker::employer::predict_placement() {
+				return api::nullopt;
+			}
+
+			std::uint8_t worker::employer::on_block_placed(message::validated_packet valid_packet, api::blob_span payload) {
+				return 0u;
+			}
+
+			worker::worker(std::shared_ptr<port_listener> listener,
+				boost::asio::io_context& net_io_ctx,
 				boost::asio::io_context& file_io_ctx,
 				boost::asio::ip::address private_mcast_addr,
 				boost::asio::ip::udp::endpoint	sender_ep,
@@ -17,78 +28,24 @@ namespace ya_uftp {
 				std::uint8_t robust,
 				task::parameters& params) :
 				m_net_io_ctx(net_io_ctx), m_file_io_ctx(file_io_ctx),
-				m_socket(m_net_io_ctx), m_sender_endpoint(sender_ep),
+				m_listener(std::move(listener)), m_sender_endpoint(sender_ep),
 				m_timeout_timer(m_net_io_ctx),
-				m_session_context(private_mcast_addr, open_group, session_id, sender_id, blk_size, robust) {
+				m_session_context(private_mcast_addr, open_group, session_id, sender_id, blk_size, robust),
+				m_packet_pool(std::max<std::size_t>(blk_size + 200u, 1500u), params.packet_pool_size, 
+					params.packet_pool_hugepages),
+				m_pending_writes(params.write_budget, params.process_write_budget) {
 
 				m_session_context.quit_on_error = params.quit_on_error;
-				auto ec = boost::system::error_code{};
-				
-				if (private_mcast_addr.is_v4()) {
-					m_socket.open(boost::asio::ip::udp::v4(), ec);
-				}
-				else {
-					m_socket.open(boost::asio::ip::udp::v6(), ec);
-				}
-
-				m_socket.set_option(boost::asio::socket_base::reuse_address(true));
-				m_socket.set_option(boost::asio::socket_base::receive_buffer_size(params.udp_buffer_size));
-
-				if (params.public_multicast_addr.is_v4()) {
-					m_socket.bind(
-						boost::asio::ip::udp::endpoint{
-							boost::asio::ip::address_v4::any(),
-							params.listen_port,
-						}, ec);
-				}
-				else {
-					m_socket.bind(
-						boost::asio::ip::udp::endpoint{
-							boost::asio::ip::address_v6::any(),
-							params.listen_port,
-						}, ec);
-				}
-
-				auto& active_interfaces = jcy::network::interface::retrieve_all();
-				for (auto& intf_info : active_interfaces) {
-					if (not intf_info.is_loopback()) {
-						for (auto& interface_addr : intf_info.unicast_addresses()) {
-							if (m_session_context.private_mcast_addr.is_v4()) {
-								auto mcast_addr = m_session_context.private_mcast_addr.to_v4();
-								if (interface_addr.is_v4() and not interface_addr.is_loopback()) {
-									m_socket.set_option(boost::asio::ip::multicast::join_group(
-										mcast_addr,
-										interface_addr.to_v4()), ec);
-									if (ec) {
-										// ToDo: part of proper logging
-										//std::cout << "Failed to join multicast group for interface " <<
-											//interface_addr.to_v4().to_string() << ", reason : " << ec.message() << '\n';
-									}
-									else {
-										//std::cout << "Successfully join multicast group for interface " <<
-											//interface_addr.to_v4().to_string() << '\n';
-									}
-								}
-							}
-							else {
-								auto mcast_addr = m_session_context.private_mcast_addr.to_v6();
-								if (interface_addr.is_v6() and not interface_addr.is_loopback()) {
-									m_socket.set_option(boost::asio::ip::multicast::join_group(
-										mcast_addr,
-										intf_info.index()), ec);
-									if (ec) {
-										//std::cout << "Failed to join multicast group for interface " <<
-											//interface_addr.to_v6().to_string() << ", reason : " << ec.message() << '\n';
-									}
-									else {
-										//std::cout << "Successfully join multicast group for interface " <<
-											//interface_addr.to_v6().to_string() << '\n';
-									}
-								}
-							}
-						}
-					}
-				}
+				m_session_context.write_run_size = params.write_run_size;
+				m_session_context.parity_memory = params.parity_memory;
+				m_session_context.map_destination_file = params.map_destination_file;
+				m_session_context.file_write_backend = params.file_write_backend;
+				m_session_context.preallocate_files = params.preallocate_files;
+				m_session_context.drop_written_pages = params.drop_written_pages;
+				if (params.file_write_backend == task::write_backend::io_uring)
+					m_write_ring = write_ring::of(m_file_io_ctx);
+				m_listener->fit_datagrams(std::max<std::size_t>(blk_size + 200u, 1500u));
+				m_listener->join(m_session_context.private_mcast_addr);
 				if (not params.client_id) {
 					auto client_id_set = false;
 					if (not params.interfaces_ids.empty()) {
@@ -153,7 +110,10 @@ namespace ya_uftp {
 				}
 			}
 
-			worker::~worker() = default;
+			worker::~worker() {
+				stop_reading();
+				m_listener->leave(m_session_context.private_mcast_addr);
+			}
 
 			bool worker::try_init_in_group_id_from_addr(const boost::asio::ip::address& uni_addr, const task::parameters& params) {
 				
@@ -176,7 +136,7 @@ namespace ya_uftp {
 				return success;
 			}
 
-			std::size_t worker::do_complete_message(message_blob msg, std::function<std::size_t(api::blob_span)> write_body) {
+			std::size_t worker::do_complete_message(const message_blob& msg, function_ref<std::size_t(api::blob_span)> write_body) {
 				auto msg_length = *(msg->data() + sizeof(message::protocol_header) + 1) * message::header_length_unit + sizeof(message::protocol_header);
 				if (write_body)
 					msg_length += write_body(api::blob_span{ msg->data() + msg_length,
@@ -187,6 +147,62 @@ namespace ya_uftp {
 			session_context& worker::get_context() {
 				return m_session_context;
 			}
+			
+			ya_uftp::detail::packet_pool& worker::packet_pool() {
+				return m_packet_pool;
+			}
+
+			task::statistics worker::statistics() const {
+				auto stats = task::statistics{};
+				stats.datagrams_received = m_datagrams_received.load(std::memory_order_relaxed);
+				stats.receive_syscalls = m_listener->receive_syscalls();
+				stats.kernel_drops = m_listener->kernel_drops();
+				stats.coalesced_datagrams = m_listener->coalesced_datagrams();
+				stats.packet_pool_misses = m_packet_pool.misses();
+				stats.receive_ring_buffers = m_listener->receive_ring_buffers();
+				stats.receive_ring_misses = m_listener->receive_ring_misses();
+				stats.disk_writes = m_disk_writes.load(std::memory_order_relaxed);
+				stats.duplicate_blocks = m_duplicate_blocks.load(std::memory_order_relaxed);
+				stats.dropped_blocks = m_dropped_blocks.load(std::memory_order_relaxed);
+				stats.rebuilt_blocks = m_rebuilt_blocks.load(std::memory_order_relaxed);
+				stats.pending_write_bytes = m_pending_writes.pending();
+				stats.pending_write_peak = m_pending_writes.peak();
+				stats.process_pending_write_bytes = write_budget::process_pending();
+				stats.placed_blocks = m_placed_blocks.load(std::memory_order_relaxed);
+				stats.misplaced_blocks = m_misplaced_blocks.load(std::memory_order_relaxed);
+				return stats;
+			}
+
+			void worker::on_disk_write() {
+				m_disk_writes.fetch_add(1u, std::memory_order_relaxed);
+			}
+
+			void worker::on_duplicate_block() {
+				m_duplicate_blocks.fetch_add(1u, std::memory_order_relaxed);
+			}
+
+			void worker::on_block_dropped() {
+				m_dropped_blocks.fetch_add(1u, std::memory_order_relaxed);
+			}
+
+			void worker::on_block_rebuilt() {
+				m_rebuilt_blocks.fetch_add(1u, std::memory_order_relaxed);
+			}
+
+			void worker::on_placed_block(bool predicted) {
+				if (predicted)
+					m_placed_blocks.fetch_add(1u, std::memory_order_relaxed);
+				else
+					m_misplaced_blocks.fetch_add(1u, std::memory_order_relaxed);
+			}
+
+			write_budget& worker::pending_writes() {
+				return m_pending_writes;
+			}
+
+			write_ring* worker::file_write_ring() {
+				return m_write_ring;
+			}
 
 			void worker::setup_header(message::protocol_header& uftp_hdr, message::role r) {
 				uftp_hdr.message_role = r;
@@ -201,7 +217,7 @@ namespace ya_uftp {
 
 			std::pair<bool, std::size_t>
 				worker::send_packet(message_blob packet,
-					std::function<std::size_t(api::blob_span)> write_body,
+					function_ref<std::size_t(api::blob_span)> write_body,
 					api::optional<std::size_t> known_length,
 					rw_handler result_handler) {
 
@@ -215,12 +231,17 @@ namespace ya_uftp {
 				else
 					msg_length = do_complete_message(packet, write_body);
 				
-				m_socket.async_send_to(boost::asio::buffer(packet->data(), msg_length),
-					m_sender_endpoint,
-					[packet, handler = std::move(result_handler), this]
-				(const boost::system::error_code ec, std::size_t bytes_sent){
-					if (handler)
-						handler(ec, bytes_sent);
+				// the socket is the listener's, it is only touched in its thread and the result comes back to this one
+				boost::asio::dispatch(m_listener->context(), [listener = m_listener, &net_io_ctx = m_net_io_ctx, 
+					packet, msg_length, sender_ep = m_sender_endpoint, handler = std::move(result_handler)]() mutable{
+					listener->socket().async_send_to(boost::asio::buffer(packet->data(), msg_length), sender_ep,
+						[packet, &net_io_ctx, handler = std::move(handler)]
+					(const boost::system::error_code ec, std::size_t bytes_sent) mutable{
+						if (handler)
+							boost::asio::dispatch(net_io_ctx, [handler = std::move(handler), ec, bytes_sent](){
+								handler(ec, bytes_sent);
+							});
+					});
 				});
 				successful = true;
 				
@@ -238,65 +259,96 @@ namespace ya_uftp {
 				return m_employer;
 			}
 
+			bool worker::accept_packet(const message::validated_packet& valid_packet) {
+				if (valid_packet.msg_header.session_id == m_session_context.session_id and
+					valid_packet.msg_header.source_id == m_session_context.sender_id) {
+					
+					m_last_msg_recv_time = std::chrono::steady_clock::now();
+					m_session_context.grtt = std::chrono::microseconds{ static_cast<std::uintmax_t>(message::dequantize_grtt(valid_packet.msg_header.grtt) * 1000000) };
+					return true;
+				}
+				return false;
+			}
+
+			void worker::deliver(const message::validated_packet& valid_packet, const message_blob& buffer) {
+				m_datagrams_received.fetch_add(1u, std::memory_order_relaxed);
+				auto boss = m_employer.lock();
+				if (boss and accept_packet(valid_packet))
+					set_timeout_factor(boss->on_message_received(valid_packet, buffer));
+			}
+
+			api::optional<worker::employer::placement> worker::predict_placement() {
+				auto boss = m_employer.lock();
+				if (not m_routed or not boss)
+					return api::nullopt;
+				return boss->predict_placement();
+			}
+
+			void worker::deliver_placed(const message::validated_packet& valid_packet, api::blob_span payload) {
+				m_datagrams_received.fetch_add(1u, std::memory_order_relaxed);
+				auto boss = m_employer.lock();
+				if (boss and accept_packet(valid_packet))
+					set_timeout_factor(boss->on_block_placed(valid_packet, payload));
+			}
+
 			void worker::loop_read_packet(bool remember_employer,
 				api::optional<std::uint8_t> timeout_factor) {
+				// the employer remembered lives as long as the datagrams of the session are routed here
 				auto the_boss = std::shared_ptr<employer>{};
 				if (remember_employer)
 					the_boss = m_employer.lock();
-				auto buf = make_message_blob(1500);
-				m_socket.async_receive_from(boost::asio::buffer(*buf),
-					m_source_ep,
-					[this, the_boss, remember_employer, buf, timeout_factor](const boost::system::error_code ec,
-						std::size_t bytes_read){
-
-					auto tof = timeout_factor;
-					if (not ec) {
-						auto boss = m_employer.lock();
-						if (boss) {
-							auto packet_span = api::blob_span{ buf->data(), static_cast<api::blob_span::size_type>(bytes_read) };
-							if (auto validated_packet = message::basic_validate_packet(packet_span); validated_packet) {
-
-								if (validated_packet->msg_header.session_id == m_session_context.session_id and
-									validated_packet->msg_header.source_id == m_session_context.sender_id) {
-									
-									m_last_msg_recv_time = std::chrono::steady_clock::now();
-									m_session_context.grtt = std::chrono::microseconds{ static_cast<std::uintmax_t>(message::dequantize_grtt(validated_packet->msg_header.grtt) * 1000000) };
-									tof = boss->on_message_received(validated_packet.value());
-								}
-							}
-							//else
-								//std::cout << "Received malformed packets\n";
-							loop_read_packet(remember_employer, tof);
-						}
-						//else
-							//std::cout << "No boss need to read the packets\n";
+				m_listener->route(m_session_context.sender_id, m_session_context.session_id, *this, 
+					std::move(the_boss), m_employer);
+				m_routed = true;
+				set_timeout_factor(timeout_factor);
+			}
+
+			void worker::stop_reading() {
+				if (not m_routed)
+					return;
+				m_routed = false;
+				m_listener->unroute(m_session_context.sender_id, m_session_context.session_id, *this);
+			}
+
+			void worker::set_timeout_factor(api::optional<std::uint8_t> timeout_factor) {
+				m_timeout_factor = timeout_factor;
+				arm_timeout_timer();
+			}
+
+			std::chrono::microseconds worker::session_timeout() const {
+				auto to = std::chrono::microseconds{ m_timeout_factor.value_or(0u) * m_session_context.grtt };
+				const auto min_timeout = std::chrono::microseconds{ std::chrono::seconds{ 10 } };
+				return to > min_timeout ? to : min_timeout;
+			}
+
+			void worker::arm_timeout_timer() {
+				if (m_timer_armed or not m_timeout_factor or m_timeout_factor.value() == 0)
+					return;
+				m_timer_armed = true;
+				m_timeout_timer.expires_after(session_timeout());
+				wait_timeout();
+			}
+
+			void worker::wait_timeout() {
+				m_timeout_timer.async_wait([this]
+					(const boost::system::error_code ec) {
+					if (ec)
+						return;
+					if (not m_timeout_factor or m_timeout_factor.value() == 0) {
+						m_timer_armed = false;
+						return;
 					}
-					else if (ec != boost::asio::error::operation_aborted and
-						not m_employer.expired()) {
-						std::cout << "received packet but not quite right\n";
-						loop_read_packet(remember_employer, tof);
+					// the timer is set once, and pushed back to the last datagram plus the timeout when it expires
+					const auto to = session_timeout();
+					if (m_last_msg_recv_time < std::chrono::steady_clock::now() - to) {
+						//std::cout << "Session timeout\n";
+						m_timer_armed = false;
+						stop_reading();
+						return;
 					}
-					//else
-						//std::cout << "received packet with error " << ec.message() << '\n';
+					m_timeout_timer.expires_at(m_last_msg_recv_time + to);
+					wait_timeout();
 				});
-
-				if (timeout_factor and
-					timeout_factor.value() > 0) {
-					auto to = timeout_factor.value() * m_session_context.grtt;
-					const auto min_timeout = std::chrono::seconds{ 10 };
-                    to = to > min_timeout ? to : min_timeout;
-					//std::cout << "Setting session timeout as " << to.count() << " microseconds\n";
-					m_timeout_timer.expires_after(to);
-					m_timeout_timer.async_wait([this, to]
-						(const boost::system::error_code ec) {
-						if (not ec) {
-							if (m_last_msg_recv_time < std::chrono::steady_clock::now() - to) {
-								//std::cout << "Session timeout\n";
-								m_socket.cancel();
-							}
-						}
-					});
-				}
 			}
 
 			void worker::
@@ -314,9 +366,7 @@ namespace ya_uftp {
 
 			void worker::cancel_all_jobs() {
 				auto ec = boost::system::error_code{};
-				m_socket.cancel(ec);
-				if (ec)
-					std::cout << "Failed to cancel socket ops. Reason: " << ec.message() << '\n';
+				stop_reading();
 
 				for (auto it = m_job_timers.begin(); it != m_job_timers.end();) {
 					auto jt = it->lock();
@@ -334,6 +384,7 @@ namespace ya_uftp {
 				}
 
 				m_timeout_timer.cancel(ec);
+				m_timer_armed = false;
 			}
 
 			void worker::execute_in_file_thread(std::function<void()> job) {
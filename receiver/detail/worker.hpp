@@ -4,35 +4,66 @@
 
 #include "receiver/adi.hpp"
 #include "receiver/detail/session_context.hpp"
+#include "receiver/detail/write_behind.hpp"
 #include "detail/common.hpp"
 
 #include <list>
 #include <random>
+#include <atomic>
+#include <memory>
 
 namespace ya_uftp{
 	namespace receiver{
 		namespace detail{
+			class port_listener;
+
 			class worker {
 				public:
 					class employer {
 					public:
+						// where the payload of a FILE_SEG is read into directly
+						struct placement {
+							std::uint8_t*	data;
+							std::size_t		length;
+						};
 						// return the number of times of GRTT for signal lost timer
-						virtual std::uint8_t on_message_received(message::validated_packet valid_packet) = 0; 
+						// the packet lives in packet_buffer, which may be kept beyond the call instead of copying the packet out
+						virtual std::uint8_t on_message_received(message::validated_packet valid_packet, 
+							const message_blob& packet_buffer) = 0; 
+						// where the payload of the next datagram probably belongs, nullopt to receive into the ring
+						virtual api::optional<placement> predict_placement();
+						// a FILE_SEG whose payload is read into the place predicted, valid_packet holds the headers only.
+						// the block may not be the one predicted, the employer checks it and moves the payload if not
+						virtual std::uint8_t on_block_placed(message::validated_packet valid_packet, api::blob_span payload);
 						virtual ~employer();
 					};
 					using rw_handler = std::function<void(const boost::system::error_code, std::size_t)>;
 				private:
 					boost::asio::io_context&		m_net_io_ctx;
 					boost::asio::io_context&		m_file_io_ctx;
-					boost::asio::ip::udp::socket	m_socket;
+					// the socket shared by all the sessions on the port, the datagrams of this one are routed here
+					std::shared_ptr<port_listener>	m_listener;
+					bool							m_routed = false;
 					boost::asio::ip::udp::endpoint	m_sender_endpoint;
-					boost::asio::ip::udp::endpoint	m_source_ep;
 					boost::asio::steady_timer		m_timeout_timer;
+					bool							m_timer_armed = false;
+					api::optional<std::uint8_t>		m_timeout_factor;
 					std::chrono::steady_clock::time_point	m_last_msg_recv_time;
 					static std::random_device		m_rd;
 					static std::uniform_int_distribution<std::uint32_t>		
 						m_rd_number_dist;
 					session_context					m_session_context;
+					ya_uftp::detail::packet_pool	m_packet_pool;
+					std::atomic<std::uint64_t>		m_datagrams_received = 0u;
+					std::atomic<std::uint64_t>		m_disk_writes = 0u;
+					std::atomic<std::uint64_t>		m_duplicate_blocks = 0u;
+					std::atomic<std::uint64_t>		m_dropped_blocks = 0u;
+					std::atomic<std::uint64_t>		m_rebuilt_blocks = 0u;
+					std::atomic<std::uint64_t>		m_placed_blocks = 0u;
+					std::atomic<std::uint64_t>		m_misplaced_blocks = 0u;
+					write_budget					m_pending_writes;
+					// nullptr unless the files are written through io_uring
+					write_ring*						m_write_ring = nullptr;
 					
 					std::weak_ptr<employer>			m_employer;
 					std::list<std::weak_ptr<boost::asio::steady_timer>>
@@ -40,10 +71,28 @@ namespace ya_uftp{
 					
 					bool try_init_in_group_id_from_addr(const boost::asio::ip::address& uni_addr, const task::parameters& params);
 					
-					static std::size_t do_complete_message(message_blob msg, std::function<std::size_t (api::blob_span)> write_body);
+					static std::size_t do_complete_message(const message_blob& msg, function_ref<std::size_t (api::blob_span)> write_body);
+					// true if the packet belongs to the session, which is then known alive
+					bool accept_packet(const message::validated_packet& valid_packet);
+					// hand a datagram routed by the listener to the employer
+					void deliver(const message::validated_packet& valid_packet, const message_blob& buffer);
+					// where the employer predicts the next block, nullopt once the session is not routed
+					api::optional<employer::placement> predict_placement();
+					// a FILE_SEG of the session whose payload the listener read into the place predicted
+					void deliver_placed(const message::validated_packet& valid_packet, api::blob_span payload);
+					// the datagrams of the session are no longer routed here, the employer kept is released
+					void stop_reading();
+					void set_timeout_factor(api::optional<std::uint8_t> timeout_factor);
+					// the session ends once nothing came for the timeout factor times GRTT, checked as the timer expires
+					void arm_timeout_timer();
+					void wait_timeout();
+					std::chrono::microseconds session_timeout() const;
 					
+					friend class port_listener;
 				public:
-					worker(boost::asio::io_context& net_io_ctx,
+					// run in net_io_ctx, the listener hands the datagrams of the session over there
+					worker(std::shared_ptr<port_listener> listener,
+						boost::asio::io_context& net_io_ctx,
 						boost::asio::io_context& file_io_ctx,
 						boost::asio::ip::address private_mcast_addr,
 						boost::asio::ip::udp::endpoint	sender_ep,
@@ -60,7 +109,7 @@ namespace ya_uftp{
 					[[nodiscard]] 
 					std::pair<bool, std::size_t> 
 						send_packet(message_blob packet, 
-						std::function<std::size_t (api::blob_span)> write_body = nullptr, 
+						function_ref<std::size_t (api::blob_span)> write_body = nullptr, 
 						api::optional<std::size_t> known_length = api::nullopt,
 						rw_handler result_handler = nullptr) ;
 					
@@ -76,6 +125,16 @@ namespace ya_uftp{
 					void execute_in_net_thread(std::function<void()> job);
 					
 					session_context& get_context() ;
+					ya_uftp::detail::packet_pool& packet_pool();
+					task::statistics statistics() const;
+					// counted by the employers for the statistics
+					void on_disk_write();
+					void on_duplicate_block();
+					void on_block_dropped();
+					void on_block_rebuilt();
+					void on_placed_block(bool predicted);
+					write_budget& pending_writes();
+					write_ring* file_write_ring();
 			};
 		}
 	}
@@ -0,0 +1,381 @@
+#include "receiver/detail/write_behind.hpp"
+#include "receiver/detail/write_ring.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <cstring>
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <climits>
+#endif
+
+namespace ya_uftp{
+	namespace receiver{
+		namespace detail{
+			namespace{
+				constexpr std::size_t default_alignment = 4096u;
+			}
+
+			std::atomic<std::size_t> write_budget::m_process_pending = 0u;
+
+			write_budget::write_budget(std::size_t session_limit, std::size_t process_limit) :
+				m_session_limit(session_limit), m_process_limit(process_limit){}
+
+			bool write_budget::try_acquire(std::size_t bytes){
+				if (m_pending.load(std::memory_order_relaxed) + bytes > m_session_limit)
+					return false;
+				// other sessions race for the process budget, only this session adds to its own
+				if (m_process_pending.fetch_add(bytes, std::memory_order_relaxed) + bytes > m_process_limit){
+					m_process_pending.fetch_sub(bytes, std::memory_order_relaxed);
+					return false;
+				}
+				const auto pending = m_pending.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+				if (pending > m_peak.load(std::memory_order_relaxed))
+					m_peak.store(pending, std::memory_order_relaxed);
+				return true;
+			}
+
+			void write_budget::release(std::size_t bytes){
+				m_pending.fetch_sub(bytes, std::memory_order_relaxed);
+				m_process_pending.fetch_sub(bytes, std::memory_order_relaxed);
+			}
+
+			std::size_t write_budget::pending() const{
+				return m_pending.load(std::memory_order_relaxed);
+			}
+
+			std::size_t write_budget::peak() const{
+				return m_peak.load(std::memory_order_relaxed);
+			}
+
+			std::size_t write_budget::process_pending(){
+				return m_process_pending.load(std::memory_order_relaxed);
+			}
+
+			write_behind::write_behind(write_budget& budget, std::size_t run_size, std::size_t alignment) :
+				m_budget(budget), m_run_size(run_size), m_alignment(alignment > 0u ? alignment : default_alignment){
+				m_run.segments.reserve(max_segments);
+			}
+
+			write_behind::~write_behind(){
+				m_budget.release(m_run.length);
+			}
+
+			bool write_behind::reserve(std::size_t bytes){
+				return m_budget.try_acquire(bytes);
+			}
+
+			api::optional<write_run> write_behind::add(message_blob owner, api::blob_view block, std::uint64_t offset){
+				auto ready = api::optional<write_run>{};
+				if (not m_run.segments.empty() and offset != m_run.offset + m_run.length)
+					ready = take();
+				if (m_run.segments.empty())
+					m_run.offset = offset;
+				m_run.segments.push_back({std::move(owner), block.data(), block.size()});
+				m_run.length += block.size();
+				if (ready or (m_run.length < m_run_size and m_run.segments.size() < max_segments))
+					return ready;
+
+				// cut at the last aligned offset, unless the run does not even reach one
+				const auto cut = (m_run.offset + m_run.length) / m_alignment * m_alignment;
+				if (cut <= m_run.offset)
+					return take();
+				return split(cut);
+			}
+
+			api::optional<write_run> write_behind::take(){
+				if (m_run.segments.empty())
+					return api::nullopt;
+				auto run = std::move(m_run);
+				m_run = write_run{};
+				m_run.segments.reserve(max_segments);
+				return run;
+			}
+
+			write_run write_behind::split(std::uint64_t cut){
+				auto head = write_run{};
+				head.offset = m_run.offset;
+				head.segments.reserve(m_run.segments.size());
+				auto tail = write_run{};
+				tail.offset = cut;
+				tail.segments.reserve(max_segments);
+				for (auto& seg : m_run.segments){
+					const auto seg_offset = head.offset + head.length;
+					if (seg_offset >= cut){
+						tail.length += seg.length;
+						tail.segments.push_back(std::move(seg));
+					}
+					else if (seg_offset + seg.length <= cut){
+						head.length += seg.length;
+						head.segments.push_back(std::move(seg));
+					}
+					else{
+						// the block straddling the boundary is written in two pieces out of the same buffer
+						const auto head_part = static_cast<std::size_t>(cut - seg_offset);
+						head.segments.push_back({seg.owner, seg.data, head_part});
+						head.length += head_part;
+						tail.segments.push_back({std::move(seg.owner), seg.data + head_part, seg.length - head_part});
+						tail.length += seg.length - head_part;
+					}
+				}
+				m_run = std::move(tail);
+				return head;
+			}
+
+#ifndef _WIN32
+			void block_writer::free_deleter::operator()(std::uint8_t* p) const{
+				std::free(p);
+			}
+
+			block_writer::block_writer(int fd, int direct_fd, std::size_t alignment, bool drop_written, private_ctor_tag tag) :
+				m_fd(fd), m_direct_fd(direct_fd), m_drop_written(drop_written), m_alignment(alignment){
+				m_iovs.reserve(write_behind::max_segments);
+			}
+
+			block_writer::~block_writer(){
+				if (m_ring)
+					m_ring->unregister_file(m_ring_slot);
+				if (m_direct_fd >= 0)
+					::close(m_direct_fd);
+				::close(m_fd);
+			}
+
+			std::unique_ptr<block_writer> block_writer::open(const api::fs::path& path, const write_options& options){
+				auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+				if (fd < 0)
+					return nullptr;
+				struct ::stat st{};
+				auto alignment = default_alignment;
+				if (::fstat(fd, &st) == 0 and st.st_blksize > 0)
+					alignment = static_cast<std::size_t>(st.st_blksize);
+				auto direct_fd = -1;
+#ifdef __linux__
+				// best effort, the file then grows block by block as before
+				if (options.preallocate_size > 0u)
+					::fallocate(fd, 0, 0, static_cast<::off_t>(options.preallocate_size));
+				// refused by some file systems, e.g. tmpfs
+				if (options.backend == task::write_backend::direct)
+					direct_fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC | O_DIRECT);
+#endif
+				auto writer = std::make_unique<block_writer>(fd, direct_fd, alignment, options.drop_written, private_ctor_tag{});
+				if (options.backend == task::write_backend::io_uring)
+					writer->m_ring = options.ring;
+				return writer;
+			}
+
+			void block_writer::submit(write_run run, std::function<void(bool)> done){
+				if (not m_ring){
+					done(write(run));
+					return;
+				}
+				if (not m_ring_slot_asked){
+					m_ring_slot = m_ring->register_file(m_fd);
+					m_ring_slot_asked = true;
+				}
+				m_in_flight++;
+				m_ring->write(m_fd, m_ring_slot, std::move(run), [this, done = std::move(done)](bool written){
+					done(written);
+					if (--m_in_flight == 0u and m_on_idle){
+						auto then = std::move(m_on_idle);
+						m_on_idle = nullptr;
+						then();
+					}
+				});
+			}
+
+			bool block_writer::write(const write_run& run){
+				const auto begin = run.offset;
+				const auto end = run.offset + run.length;
+				if (m_direct_fd >= 0){
+					// only whole file system blocks bypass the page cache, the edges are merged there with their neighbours
+					const auto direct_begin = (begin + m_alignment - 1) / m_alignment * m_alignment;
+					const auto direct_end = end / m_alignment * m_alignment;
+					if (direct_begin < direct_end)
+						return write_buffered(run, begin, direct_begin) and 
+							write_direct(run, direct_begin, direct_end) and 
+							write_buffered(run, direct_end, end);
+				}
+				return write_buffered(run, begin, end);
+			}
+
+			bool block_writer::write_buffered(const write_run& run, std::uint64_t from, std::uint64_t to){
+				if (from >= to)
+					return true;
+				m_iovs.clear();
+				auto seg_offset = run.offset;
+				for (auto& seg : run.segments){
+					const auto first = std::max(seg_offset, from);
+					const auto last = std::min(seg_offset + seg.length, to);
+					if (first < last)
+						m_iovs.push_back({const_cast<std::uint8_t*>(seg.data) + (first - seg_offset), 
+							static_cast<std::size_t>(last - first)});
+					seg_offset += seg.length;
+				}
+				if (not write_vectors(from))
+					return false;
+				if (m_drop_written)
+					drop_behind(from, static_cast<std::size_t>(to - from));
+				return true;
+			}
+
+			bool block_writer::write_direct(const write_run& run, std::uint64_t from, std::uint64_t to){
+				const auto length = static_cast<std::size_t>(to - from);
+				if (m_staging_size < length){
+					auto memory = static_cast<void*>(nullptr);
+					if (::posix_memalign(&memory, m_alignment, length) != 0)
+						return write_buffered(run, from, to);
+					m_staging.reset(static_cast<std::uint8_t*>(memory));
+					m_staging_size = length;
+				}
+				// the receive buffers are not aligned, gather the blocks into the staging buffer
+				auto seg_offset = run.offset;
+				for (auto& seg : run.segments){
+					const auto first = std::max(seg_offset, from);
+					const auto last = std::min(seg_offset + seg.length, to);
+					if (first < last)
+						std::memcpy(m_staging.get() + (first - from), seg.data + (first - seg_offset), 
+							static_cast<std::size_t>(last - first));
+					seg_offset += seg.length;
+				}
+				auto written = std::size_t(0u);
+				while (written < length){
+					auto result = ::pwrite(m_direct_fd, m_staging.get() + written, length - written, 
+						static_cast<::off_t>(from + written));
+					if (result < 0){
+						if (errno == EINTR)
+							continue;
+						// the device wants a coarser alignment than the file system reports, go through the page cache
+						if (errno == EINVAL and written == 0u){
+							::close(m_direct_fd);
+							m_direct_fd = -1;
+							return write_buffered(run, from, to);
+						}
+						return false;
+					}
+					written += static_cast<std::size_t>(result);
+				}
+				return true;
+			}
+
+			void block_writer::drop_behind(std::uint64_t offset, std::size_t length){
+#ifdef __linux__
+				// the pages are dirty until written back, which is started now so they are clean by the next run
+				::sync_file_range(m_fd, static_cast<::off_t>(offset), static_cast<::off_t>(length), SYNC_FILE_RANGE_WRITE);
+#endif
+				if (m_written_length > 0u)
+					::posix_fadvise(m_fd, static_cast<::off_t>(m_written_offset), static_cast<::off_t>(m_written_length), 
+						POSIX_FADV_DONTNEED);
+				m_written_offset = offset;
+				m_written_length = length;
+			}
+
+			bool block_writer::write_vectors(std::uint64_t from){
+				auto offset = static_cast<::off_t>(from);
+				auto first = std::size_t(0u);
+				while (first < m_iovs.size()){
+					const auto count = static_cast<int>(std::min<std::size_t>(m_iovs.size() - first, IOV_MAX));
+					auto written = ::pwritev(m_fd, m_iovs.data() + first, count, offset);
+					if (written < 0){
+						if (errno == EINTR)
+							continue;
+						return false;
+					}
+					offset += written;
+					// skip what is written, the partly written segment resumes where it stops
+					auto left = static_cast<std::size_t>(written);
+					while (first < m_iovs.size() and left >= m_iovs[first].iov_len)
+						left -= m_iovs[first++].iov_len;
+					if (left > 0u){
+						m_iovs[first].iov_base = static_cast<std::uint8_t*>(m_iovs[first].iov_base) + left;
+						m_iovs[first].iov_len -= left;
+					}
+				}
+				return true;
+			}
+#else
+			block_writer::block_writer(std::ofstream stream, private_ctor_tag tag) :
+				m_stream(std::move(stream)), m_alignment(default_alignment){}
+
+			block_writer::~block_writer() = default;
+
+			std::unique_ptr<block_writer> block_writer::open(const api::fs::path& path, const write_options& options){
+				auto stream = std::ofstream{path.string(), std::ios_base::binary | std::ios_base::out};
+				if (not stream.is_open())
+					return nullptr;
+				return std::make_unique<block_writer>(std::move(stream), private_ctor_tag{});
+			}
+
+			bool block_writer::write(const write_run& run){
+				m_stream.seekp(run.offset);
+				for (auto& seg : run.segments)
+					m_stream.write(reinterpret_cast<const char*>(seg.data), seg.length);
+				return m_stream.good();
+			}
+
+			void block_writer::submit(write_run run, std::function<void(bool)> done){
+				done(write(run));
+			}
+#endif
+
+			void block_writer::finish(std::function<void()> then){
+				if (m_in_flight == 0u)
+					then();
+				else
+					m_on_idle = std::move(then);
+			}
+
+			std::size_t block_writer::alignment() const{
+				return m_alignment;
+			}
+
+			mapped_destination::mapped_destination(int fd, std::uint8_t* data, std::size_t size, private_ctor_tag tag) :
+				m_fd(fd), m_data(data), m_size(size){}
+
+#ifndef _WIN32
+			mapped_destination::~mapped_destination(){
+				::munmap(m_data, m_size);
+				::close(m_fd);
+			}
+
+			std::unique_ptr<mapped_destination> mapped_destination::open(const api::fs::path& path, std::uintmax_t size){
+				if (size == 0u or size > std::numeric_limits<std::size_t>::max())
+					return nullptr;
+				auto fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+				if (fd < 0)
+					return nullptr;
+				// the blocks must never fault for want of space, which would be a SIGBUS rather than an error
+				if (::posix_fallocate(fd, 0, static_cast<::off_t>(size)) != 0){
+					::close(fd);
+					return nullptr;
+				}
+				auto data = ::mmap(nullptr, static_cast<std::size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+				if (data == MAP_FAILED){
+					::close(fd);
+					return nullptr;
+				}
+				return std::make_unique<mapped_destination>(fd, static_cast<std::uint8_t*>(data), 
+					static_cast<std::size_t>(size), private_ctor_tag{});
+			}
+#else
+			mapped_destination::~mapped_destination() = default;
+
+			std::unique_ptr<mapped_destination> mapped_destination::open(const api::fs::path& path, std::uintmax_t size){
+				return nullptr;
+			}
+#endif
+
+			std::uint8_t* mapped_destination::data(){
+				return m_data;
+			}
+
+			std::size_t mapped_destination::size() const{
+				return m_size;
+			}
+		}
+	}
+}
@@ -0,0 +1,171 @@
+#pragma once
+#ifndef YA_UFTP_RECEIVER_DETAIL_WRITE_BEHIND_HPP_
+#define YA_UFTP_RECEIVER_DETAIL_WRITE_BEHIND_HPP_
+
+#include "api_binder.hpp"
+#include "receiver/adi.hpp"
+#include "detail/packet_pool.hpp"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <sys/uio.h>
+#endif
+
+namespace ya_uftp{
+	namespace receiver{
+		namespace detail{
+			// a contiguous range of the file, gathered in place from the receive buffers holding the blocks
+			struct write_run{
+				struct segment{
+					message_blob		owner;
+					const std::uint8_t*	data;
+					std::size_t			length;
+				};
+				std::uint64_t			offset = 0u;
+				std::size_t				length = 0u;
+				std::vector<segment>	segments;
+			};
+
+			// bytes of the blocks received but not written yet, bounded per session and for the whole process.
+			// a block which does not fit is dropped and left to be NAKed, rather than buffered without bound
+			class write_budget{
+				static std::atomic<std::size_t>	m_process_pending;
+				std::atomic<std::size_t>		m_pending = 0u;
+				std::atomic<std::size_t>		m_peak = 0u;
+				const std::size_t				m_session_limit;
+				const std::size_t				m_process_limit;
+			public:
+				write_budget(std::size_t session_limit, std::size_t process_limit);
+				write_budget(const write_budget&) = delete;
+				write_budget& operator=(const write_budget&) = delete;
+				
+				bool try_acquire(std::size_t bytes);
+				void release(std::size_t bytes);
+				std::size_t pending() const;
+				std::size_t peak() const;
+				static std::size_t process_pending();
+			};
+
+			// keeps the received blocks as contiguous runs in the net thread until a run is worth a write.
+			// a full run is cut at the last file system block boundary, the rest of it starts the next run
+			class write_behind{
+				write_budget&	m_budget;
+				write_run		m_run;
+				std::size_t		m_run_size;
+				std::size_t		m_alignment;
+
+				write_run split(std::uint64_t cut);
+			public:
+				// a pwritev() takes at most IOV_MAX(1024 on Linux) segments
+				static constexpr std::size_t	max_segments = 512u;
+
+				// the blocks added are charged to the budget, the writer of a run releases its length
+				write_behind(write_budget& budget, std::size_t run_size, std::size_t alignment);
+				write_behind(const write_behind&) = delete;
+				write_behind& operator=(const write_behind&) = delete;
+				// the run kept is never written, give it back
+				~write_behind();
+				// false when the budget is exhausted, the block is then dropped
+				bool reserve(std::size_t bytes);
+				// the run to be written now, if the block completes or breaks one
+				api::optional<write_run> add(message_blob owner, api::blob_view block, std::uint64_t offset);
+				// the run kept so far, if any
+				api::optional<write_run> take();
+			};
+
+			class write_ring;
+
+			struct write_options{
+				task::write_backend		backend = task::write_backend::buffered;
+				// the size to preallocate, 0 for none
+				std::uintmax_t			preallocate_size = 0u;
+				bool					drop_written = false;
+				// the ring of the disk thread the runs are submitted to, nullptr to write them in place
+				write_ring*				ring = nullptr;
+			};
+
+			// the destination file, written run by run in the file thread
+			class block_writer{
+				struct private_ctor_tag{};
+#ifdef _WIN32
+				std::ofstream			m_stream;
+#else
+				struct free_deleter{
+					void operator()(std::uint8_t* p) const;
+				};
+				int						m_fd;
+				// the same file opened with O_DIRECT, -1 when every write goes through the page cache
+				int						m_direct_fd;
+				std::vector<::iovec>	m_iovs;
+				// the aligned copy of the part of a run written by O_DIRECT
+				std::unique_ptr<std::uint8_t, free_deleter>	m_staging;
+				std::size_t				m_staging_size = 0u;
+				bool					m_drop_written;
+				// the range written last, dropped from the page cache once the next one is written
+				std::uint64_t			m_written_offset = 0u;
+				std::size_t				m_written_length = 0u;
+				write_ring*				m_ring = nullptr;
+				// the fixed file slot in the ring, taken on the first submission
+				int						m_ring_slot = -1;
+				bool					m_ring_slot_asked = false;
+
+				// the bytes [from, to) of the run
+				bool write_buffered(const write_run& run, std::uint64_t from, std::uint64_t to);
+				bool write_direct(const write_run& run, std::uint64_t from, std::uint64_t to);
+				bool write_vectors(std::uint64_t offset);
+				void drop_behind(std::uint64_t offset, std::size_t length);
+#endif
+				std::size_t				m_alignment;
+				// the runs submitted but not written yet, and what is to be done once there is none
+				std::size_t				m_in_flight = 0u;
+				std::function<void()>	m_on_idle;
+			public:
+#ifdef _WIN32
+				block_writer(std::ofstream stream, private_ctor_tag tag);
+#else
+				block_writer(int fd, int direct_fd, std::size_t alignment, bool drop_written, private_ctor_tag tag);
+#endif
+				block_writer(const block_writer&) = delete;
+				block_writer& operator=(const block_writer&) = delete;
+				~block_writer();
+
+				// create or truncate the file, nullptr if it can not be opened
+				static std::unique_ptr<block_writer> open(const api::fs::path& path, const write_options& options);
+				// the preferred size of the writes of the file system, the runs are cut at its multiples
+				std::size_t alignment() const;
+				// false on error
+				bool write(const write_run& run);
+				// write the run through the ring if any, otherwise right now. done(false) on error
+				void submit(write_run run, std::function<void(bool)> done);
+				// then() once every run submitted is written, the writer may be destroyed from there
+				void finish(std::function<void()> then);
+			};
+
+			// the destination file preallocated at its full size and mapped, the blocks land in place without a write.
+			// touched in the net thread only, unmapped in the file thread once the file is complete
+			class mapped_destination{
+				struct private_ctor_tag{};
+				int						m_fd;
+				std::uint8_t*			m_data;
+				std::size_t				m_size;
+			public:
+				mapped_destination(int fd, std::uint8_t* data, std::size_t size, private_ctor_tag tag);
+				mapped_destination(const mapped_destination&) = delete;
+				mapped_destination& operator=(const mapped_destination&) = delete;
+				~mapped_destination();
+
+				// create or truncate the file, nullptr if it can not be preallocated or mapped
+				static std::unique_ptr<mapped_destination> open(const api::fs::path& path, std::uintmax_t size);
+				std::uint8_t* data();
+				std::size_t size() const;
+			};
+		}
+	}
+}
+
+#endif
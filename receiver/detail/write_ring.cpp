@@ -0,0 +1,278 @@
+#include "receiver/detail/write_ring.hpp"
+
+#include <algorithm>
+#ifdef YA_UFTP_HAS_IO_URING
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <climits>
+#endif
+
+namespace ya_uftp{
+	namespace receiver{
+		namespace detail{
+			boost::asio::execution_context::id write_ring::id;
+
+			struct write_ring::pending_write{
+				int						fd;
+				int						slot;
+				std::uint64_t			offset;
+				write_run				run;
+				// what is left to write starts at iovs[first]
+				std::vector<::iovec>	iovs;
+				std::size_t				first = 0u;
+				completion_handler		done;
+			};
+
+			write_ring* write_ring::of(boost::asio::io_context& ctx){
+				auto& ring = boost::asio::use_service<write_ring>(ctx);
+#ifdef YA_UFTP_HAS_IO_URING
+				if (ring.m_ring)
+					return &ring;
+#endif
+				return nullptr;
+			}
+
+#ifdef YA_UFTP_HAS_IO_URING
+			namespace{
+				constexpr unsigned ring_entries = 256u;
+				// how soon the writes an enter refused are tried again when none is in flight to wake the thread
+				constexpr auto retry_delay = std::chrono::milliseconds(1);
+
+				// io_uring_setup may succeed while the writes are still refused(old kernels, seccomp), try one for real
+				bool can_write_through(ya_uftp::detail::io_ring& ring){
+					auto fd = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+					if (fd < 0)
+						return false;
+					auto byte = std::uint8_t{0u};
+					auto iov = ::iovec{&byte, 1u};
+					auto sqe = ring.get_sqe();
+					sqe->opcode = IORING_OP_WRITEV;
+					sqe->fd = fd;
+					sqe->addr = reinterpret_cast<std::uint64_t>(&iov);
+					sqe->len = 1u;
+					auto result = -1;
+					if (ring.submit(1u) >= 0)
+						ring.consume_completions([&result](const ::io_uring_cqe& cqe){ result = cqe.res; });
+					::close(fd);
+					return result == 1;
+				}
+			}
+
+			write_ring::write_ring(boost::asio::execution_context& ctx) :
+				boost::asio::execution_context::service(ctx),
+				m_ctx(static_cast<boost::asio::io_context&>(ctx)),
+				m_event(m_ctx),
+				m_retry(m_ctx){
+				auto ring = ya_uftp::detail::io_ring::create(ring_entries);
+				if (not ring or not can_write_through(*ring))
+					return;
+				auto efd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+				if (efd < 0)
+					return;
+				if (ring->register_resource(IORING_REGISTER_EVENTFD, &efd, 1u) < 0){
+					::close(efd);
+					return;
+				}
+				auto ec = boost::system::error_code{};
+				m_event.assign(efd, ec);
+				if (ec){
+					::close(efd);
+					return;
+				}
+				m_ring = std::move(ring);
+			}
+
+			write_ring::~write_ring() = default;
+
+			void write_ring::shutdown(){
+				m_shut_down = true;
+				auto ec = boost::system::error_code{};
+				m_event.close(ec);
+				m_retry.cancel();
+				m_backlog.clear();
+				// the kernel may still be reading the buffers, wait for it before they are freed.
+				// the writes left in the ring are submitted too, their buffers are only freed by their completion
+				while (m_ring and (m_in_flight > 0u or m_ring->unsubmitted() > 0u)){
+					auto result = m_ring->submit(m_in_flight > 0u ? 1u : 0u);
+					if (result > 0)
+						m_in_flight += static_cast<unsigned>(result);
+					else if (result < 0 and result != -EAGAIN and result != -EBUSY)
+						break;
+					else if (m_in_flight == 0u and result == 0)
+						break;
+					m_in_flight -= m_ring->consume_completions([](const ::io_uring_cqe& cqe){
+						delete reinterpret_cast<pending_write*>(cqe.user_data);
+					});
+				}
+			}
+
+			int write_ring::register_file(int fd){
+				if (not m_files_registered){
+					auto table = std::vector<int>(fixed_files_count, -1);
+					if (m_ring->register_resource(IORING_REGISTER_FILES, table.data(), fixed_files_count) < 0)
+						return -1;
+					m_used_slots.assign(fixed_files_count, false);
+					m_files_registered = true;
+				}
+				auto it = std::find(m_used_slots.begin(), m_used_slots.end(), false);
+				if (it == m_used_slots.end())
+					return -1;
+				const auto slot = static_cast<int>(it - m_used_slots.begin());
+				auto update = ::io_uring_files_update{};
+				update.offset = static_cast<std::uint32_t>(slot);
+				update.fds = reinterpret_cast<std::uint64_t>(&fd);
+				if (m_ring->register_resource(IORING_REGISTER_FILES_UPDATE, &update, 1u) < 0)
+					return -1;
+				*it = true;
+				return slot;
+			}
+
+			void write_ring::unregister_file(int slot){
+				if (slot < 0 or m_shut_down)
+					return;
+				// the file stays open until its slot is cleared, whoever closed its own descriptor
+				boost::asio::post(m_ctx, [this, slot](){
+					if (m_shut_down)
+						return;
+					auto fd = -1;
+					auto update = ::io_uring_files_update{};
+					update.offset = static_cast<std::uint32_t>(slot);
+					update.fds = reinterpret_cast<std::uint64_t>(&fd);
+					m_ring->register_resource(IORING_REGISTER_FILES_UPDATE, &update, 1u);
+					m_used_slots[static_cast<std::size_t>(slot)] = false;
+				});
+			}
+
+			void write_ring::write(int fd, int slot, write_run run, completion_handler done){
+				auto op = std::make_unique<pending_write>();
+				op->fd = fd;
+				op->slot = slot;
+				op->offset = run.offset;
+				op->iovs.reserve(run.segments.size());
+				for (auto& seg : run.segments)
+					op->iovs.push_back({const_cast<std::uint8_t*>(seg.data), seg.length});
+				op->run = std::move(run);
+				op->done = std::move(done);
+				m_backlog.push_back(std::move(op));
+				submit_backlog();
+			}
+
+			bool write_ring::prepare(pending_write& op){
+				auto sqe = m_ring->get_sqe();
+				if (not sqe)
+					return false;
+				sqe->opcode = IORING_OP_WRITEV;
+				if (op.slot >= 0){
+					sqe->fd = op.slot;
+					sqe->flags = IOSQE_FIXED_FILE;
+				}
+				else
+					sqe->fd = op.fd;
+				sqe->off = op.offset;
+				sqe->addr = reinterpret_cast<std::uint64_t>(op.iovs.data() + op.first);
+				sqe->len = static_cast<std::uint32_t>(std::min<std::size_t>(op.iovs.size() - op.first, IOV_MAX));
+				sqe->user_data = reinterpret_cast<std::uint64_t>(&op);
+				return true;
+			}
+
+			void write_ring::submit_backlog(){
+				// the completion queue is twice the submission queue, keeping at most entries() in flight never overflows it
+				while (not m_backlog.empty() and m_in_flight + m_ring->unsubmitted() < m_ring->entries() and 
+					prepare(*m_backlog.front())){
+					m_backlog.front().release();
+					m_backlog.pop_front();
+				}
+				enter();
+				arm();
+			}
+
+			void write_ring::enter(){
+				if (m_ring->unsubmitted() == 0u)
+					return;
+				// the writes the kernel refused stay in the ring, the next enter submits them again
+				if (auto result = m_ring->submit(); result > 0)
+					m_in_flight += static_cast<unsigned>(result);
+				if (m_ring->unsubmitted() == 0u or m_in_flight > 0u or m_retrying)
+					return;
+				// no completion is coming to wake the thread
+				m_retrying = true;
+				m_retry.expires_after(retry_delay);
+				m_retry.async_wait([this](const boost::system::error_code ec){
+					m_retrying = false;
+					if (ec or m_shut_down)
+						return;
+					submit_backlog();
+				});
+			}
+
+			void write_ring::arm(){
+				if (m_armed or m_in_flight == 0u)
+					return;
+				m_armed = true;
+				m_event.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+					[this](const boost::system::error_code ec){
+					m_armed = false;
+					if (ec)
+						return;
+					auto count = std::uint64_t{};
+					[[maybe_unused]] auto cleared = ::read(m_event.native_handle(), &count, sizeof(count));
+					on_completions();
+				});
+			}
+
+			void write_ring::on_completions(){
+				// the handlers may close files or write again, so run them once the queue is drained
+				auto reaped = std::vector<std::pair<pending_write*, std::int32_t>>{};
+				m_in_flight -= m_ring->consume_completions([&reaped](const ::io_uring_cqe& cqe){
+					reaped.emplace_back(reinterpret_cast<pending_write*>(cqe.user_data), cqe.res);
+				});
+				for (auto [raw_op, result] : reaped){
+					auto op = std::unique_ptr<pending_write>(raw_op);
+					if (result == -EINTR or result == -EAGAIN){
+						m_backlog.push_front(std::move(op));
+						continue;
+					}
+					if (result <= 0){
+						op->done(false);
+						continue;
+					}
+					op->offset += static_cast<std::uint64_t>(result);
+					// skip what is written, the partly written segment resumes where it stops
+					auto left = static_cast<std::size_t>(result);
+					while (op->first < op->iovs.size() and left >= op->iovs[op->first].iov_len)
+						left -= op->iovs[op->first++].iov_len;
+					if (left > 0u){
+						op->iovs[op->first].iov_base = static_cast<std::uint8_t*>(op->iovs[op->first].iov_base) + left;
+						op->iovs[op->first].iov_len -= left;
+					}
+					if (op->first < op->iovs.size())
+						m_backlog.push_front(std::move(op));
+					else
+						op->done(true);
+				}
+				submit_backlog();
+			}
+#else
+			write_ring::write_ring(boost::asio::execution_context& ctx) :
+				boost::asio::execution_context::service(ctx){}
+
+			write_ring::~write_ring() = default;
+
+			void write_ring::shutdown(){}
+
+			int write_ring::register_file(int fd){
+				return -1;
+			}
+
+			void write_ring::unregister_file(int slot){}
+
+			void write_ring::write(int fd, int slot, write_run run, completion_handler done){
+				done(false);
+			}
+#endif
+		}
+	}
+}
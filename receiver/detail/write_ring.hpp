@@ -0,0 +1,69 @@
+#pragma once
+#ifndef YA_UFTP_RECEIVER_DETAIL_WRITE_RING_HPP_
+#define YA_UFTP_RECEIVER_DETAIL_WRITE_RING_HPP_
+
+#include "receiver/detail/write_behind.hpp"
+#include "detail/io_ring.hpp"
+#include "boost/asio.hpp"
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace ya_uftp{
+	namespace receiver{
+		namespace detail{
+			// one io_uring per disk thread, shared by the files of every session the thread writes.
+			// the runs are submitted and completed in the disk thread, woken by an eventfd registered with the ring
+			class write_ring : public boost::asio::execution_context::service{
+			public:
+				using completion_handler = std::function<void(bool)>;
+				static boost::asio::execution_context::id	id;
+
+				explicit write_ring(boost::asio::execution_context& ctx);
+				write_ring(const write_ring&) = delete;
+				write_ring& operator=(const write_ring&) = delete;
+				~write_ring();
+				// the ring of the disk thread running ctx, nullptr when io_uring is not available
+				static write_ring* of(boost::asio::io_context& ctx);
+
+				// a fixed file slot for fd, -1 when there is none left. disk thread only
+				int register_file(int fd);
+				// any thread, the slot is released in the disk thread
+				void unregister_file(int slot);
+				// write the whole run at fd, through its fixed file slot if any. disk thread only,
+				// done is called there with false on error
+				void write(int fd, int slot, write_run run, completion_handler done);
+			private:
+				struct pending_write;
+
+				void shutdown() override;
+#ifdef YA_UFTP_HAS_IO_URING
+				// the fixed file table is registered once, the files then take and give back its slots
+				static constexpr unsigned	fixed_files_count = 64u;
+
+				boost::asio::io_context&					m_ctx;
+				std::unique_ptr<ya_uftp::detail::io_ring>	m_ring;
+				boost::asio::posix::stream_descriptor		m_event;
+				boost::asio::steady_timer					m_retry;
+				std::deque<std::unique_ptr<pending_write>>	m_backlog;
+				std::vector<bool>							m_used_slots;
+				// the writes the kernel has taken, those left in the ring by a refused enter are not counted
+				unsigned									m_in_flight = 0u;
+				bool										m_armed = false;
+				bool										m_retrying = false;
+				bool										m_files_registered = false;
+				bool										m_shut_down = false;
+
+				void submit_backlog();
+				bool prepare(pending_write& op);
+				void enter();
+				void arm();
+				void on_completions();
+#endif
+			};
+		}
+	}
+}
+
+#endif
@@ -28,10 +28,47 @@ namespace ya_uftp {
 				forced_end
 			};
 			
+			enum class read_backend{
+				// io_uring when the kernel allows it, otherwise the thread pool
+				automatic,
+				io_uring,
+				// pread() from a few threads
+				thread_pool,
+				// std::ifstream on the disk thread, no read ahead at all
+				stream
+			};
+			
+			struct queue_statistics{
+				// datagrams waiting in the queue right now
+				std::uint64_t	depth = 0u;
+				// datagrams which have left the queue for the kernel so far
+				std::uint64_t	datagrams = 0u;
+				// from send_packet() to the hand over to the kernel
+				std::chrono::microseconds	average_wait{0};
+				std::chrono::microseconds	max_wait{0};
+			};
+			
+			struct statistics{
+				std::uint64_t	datagrams_sent = 0u;
+				std::uint64_t	send_syscalls = 0u;
+				// packets which did not fit or found the packet pool drained, thus allocated from the heap
+				std::uint64_t	packet_pool_misses = 0u;
+				// sends whose pages the kernel released after transmitting them in place
+				std::uint64_t	zero_copy_sends = 0u;
+				// sends the kernel fell back to copying, zero copy is turned off after the first one
+				std::uint64_t	zero_copy_copied = 0u;
+				// the control messages skip ahead of the FILE_SEG and FILE_PARITY, thus have their own queue
+				queue_statistics	control_queue;
+				queue_statistics	data_queue;
+				// tell how well the outgoing datagrams are batched, 1.0 means no batching at all
+				double datagrams_per_syscall() const;
+			};
+			
 			struct progress{
                 std::uint32_t	session_id;
 				status 			current_status;
                 api::fs::path	current_file;
+				statistics		stats;
 				using listener = std::function<void (const progress&)>;
 			};
 			
@@ -53,6 +90,14 @@ namespace ya_uftp {
 					api::optional<api::fs::path>	dest_path;
 				};
 				
+				// each data_blocks blocks of a section are followed by parity_blocks Reed-Solomon parity blocks,
+				// a receiver losing up to parity_blocks of them rebuilds those without asking.
+				// data_blocks + parity_blocks is at most 256
+				struct fec_ratio{
+					std::uint8_t	data_blocks = 32u;
+					std::uint8_t	parity_blocks = 2u;
+				};
+				
 				using file_list = api::variant<api::fs::path, std::vector<single_file>>;
 				file_list					files;
 				api::optional<api::fs::path>	base_dir;
@@ -72,7 +117,40 @@ namespace ya_uftp {
 				std::uint16_t				block_size = 1300u;
 				bool						follow_symbolic_link = false;
 				bool						quit_on_error = false;
+				// in bytes per second, the datagrams are paced evenly at this rate
 				api::optional<std::uint64_t>		max_speed;
+				// bytes the pacer may release back to back, larger bursts need less timer wakeups at high speeds.
+				// the least burst, at high speeds the pacer takes what 250us of max_speed earns
+				std::size_t					pacing_burst_size = 16 * 1024;
+				// also hand the speed to the kernel by SO_MAX_PACING_RATE, which the fq qdisc enforces per datagram
+				bool						kernel_pacing = true;
+				// hand consecutive equal sized FILE_SEG to the kernel as one UDP_SEGMENT super datagram when supported,
+				// silently fallback to plain datagrams when the kernel or the route refuse it
+				bool						enable_udp_gso = false;
+				// count of preallocated packet buffers per session, each is block_size + 200 bytes
+				std::size_t					packet_pool_size = 2048u;
+				// back the packet pool by hugepages when the system has them reserved
+				bool						packet_pool_hugepages = false;
+				// how the file blocks are read from the disk
+				read_backend				file_read_backend = read_backend::automatic;
+				// the sequential reads are issued chunk by chunk ahead of the sending, 
+				// read_ahead_window chunks are in flight or ready at most
+				std::size_t					read_ahead_chunk_size = 1024 * 1024;
+				std::size_t					read_ahead_window = 8u;
+				// map the source files and send the blocks straight from the page cache with MSG_ZEROCOPY(Linux only),
+				// the blocks are still gathered from the mapping without a copy when the kernel refuses MSG_ZEROCOPY
+				bool						zero_copy_send = false;
+				// resend first the lost blocks the most receivers miss, otherwise in file order.
+				// costs 2 bytes per block of the file being sent
+				bool						repair_by_demand = false;
+				// while the file is first sent, ask the receivers for the blocks they lost by a DONE every this many sections
+				// and resend those amid the sending. nullopt to ask only once the whole file is sent
+				api::optional<std::uint16_t>		section_feedback_interval;
+				// offered in ANNOUNCE, the parity is sent while the file is first sent once any receiver takes it
+				api::optional<fec_ratio>			fec;
+				// resend the lost blocks of a group once as fresh parity blocks, as many as the receiver missing the most
+				// of the group lacks, when every receiver takes the fec. costs 2 bytes per block of the file being sent
+				bool						repair_by_parity = false;
 				// ------ start of Not-Yet-Supported features ------
 				bool						need_authenticate_clients = false;
 				api::optional<std::vector<client_info>>	allowed_clients;
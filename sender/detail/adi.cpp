@@ -7,4 +7,8 @@ namespace ya_uftp::sender::task{
 	parameters& parameters::operator=(const parameters&) = default;
 	parameters& parameters::operator=(parameters&&) = default;
 	parameters::~parameters() = default;
+	
+	double statistics::datagrams_per_syscall() const{
+		return send_syscalls > 0u ? static_cast<double>(datagrams_sent) / send_syscalls : 0.0;
+	}
 }
\ No newline at end of file
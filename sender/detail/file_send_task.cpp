@@ -4,6 +4,9 @@
 #include "detail/progress_notification.hpp"
 
 #include <type_traits>
+#include <algorithm>
+#include <limits>
+#include <utility>
 #include <iostream>
 #include "boost/endian/conversion.hpp"
 
@@ -165,8 +168,8 @@ namespace ya_uftp{
 								prop.current_status = session_context::receiver_properties::status::lost;
 						}
 						auto transfer_content = [this_task = shared_from_this()](){ 
-						this_task->m_worker.execute_in_file_thread(
-						[this_task](){this_task->do_transfer(); });};
+							this_task->start_production();
+						};
 						m_worker.schedule_job_after(m_context.grtt * 3, std::move(transfer_content));
 					}
 					else {
@@ -179,7 +182,7 @@ namespace ya_uftp{
 					}
 				};
 
-				core::detail::progress_notification::get().post_progress({id(), task::status::announcing, m_local_path});
+				core::detail::progress_notification::get().post_progress({id(), task::status::announcing, m_local_path, m_worker.statistics()});
 				auto [all_sent, bytes_sent] = m_worker.send_to_targeted_receivers(msg, m_context.private_mcast_dest, all_living);
 				if (all_sent){
 					next_step();
@@ -190,197 +193,452 @@ namespace ya_uftp{
 				}
 			}
 			
-			void files_delivery_session::file_send_task::do_transfer(){
-				auto rewind = true;
-				while(rewind){
-					rewind = false;
-					std::unique_lock state_lock(m_state_mutex);
-					auto blocked = false;
-					if (m_phase == phase::sending){
-                        core::detail::progress_notification::get().post_progress({id(), task::status::transferring, m_local_path});
-						while (not m_reach_eof){
-							state_lock.unlock();
-							auto blk_idx = m_current_block_idx++;
-							// only when we are sending section by section, the eof() can indicate
-							// we've completely send the whole file(modul).
-							// we can reach eof() during resend lost blocks too, don't do it there
-							if (m_current_block_idx >= m_block_count){
-								m_reach_eof = true;
-								//std::cout << "Last block sent is " << blk_idx << '\n';
-							}
-							if (do_send_one_block(blk_idx)){
-								state_lock.lock();
-								if (m_phase == phase::sending)
-									continue;
-								else
-									break;
-							}
-							else{
-								state_lock.lock();
-								blocked = true;
-								break;
-							}
-						}
-						
-						if (m_reach_eof){
-							if (not blocked){
-								m_phase = phase::waiting_client_status;
-								state_lock.unlock();
-								m_worker.execute_in_net_thread([this_task = shared_from_this()](){
-									this_task->do_send_done();
-								});
-							}
-						}
+			void files_delivery_session::file_send_task::start_production(){
+				auto job = production_job{};
+				if (m_phase == phase::sending){
+					core::detail::progress_notification::get().post_progress({id(), task::status::transferring, m_local_path, m_worker.statistics()});
+					job.end = m_block_count;
+					m_sent_through = 0u;
+					m_section_done_after = api::nullopt;
+					if (const auto interval = m_parent_session->m_section_feedback_interval; 
+						interval > 0u and interval < m_section_count){
+						m_feedback_section = interval - 1u;
+						m_feedback_block = sect_blk_to_abs_block_idx(interval, 0u);
+					}
+					// the parity is worth its bandwidth only when some receiver decodes it
+					const auto takes_fec = [](const auto& receiver){
+						return receiver.second.fec and 
+							receiver.second.current_status == session_context::receiver_properties::status::active;
+					};
+					if (m_context.fec and std::any_of(m_context.receivers_properties.begin(), 
+						m_context.receivers_properties.end(), takes_fec))
+						job.fec.emplace(m_context.fec->data_blocks, m_context.fec->parity_blocks);
+				}
+				else{
+					core::detail::progress_notification::get().post_progress(
+						{id(), task::status::restransferring, m_local_path, m_worker.statistics()});
+					job.sequential = false;
+					if (not m_parity_demand.empty()){
+						collect_parity_repairs(job.parity_repairs);
+						if (not job.parity_repairs.empty())
+							job.fec.emplace(m_context.fec->data_blocks, m_context.fec->parity_blocks);
+					}
+					collect_repairs(job.repairs);
+					job.end = job.repairs.size();
+				}
+				job.end_marked = false;
+				m_worker.execute_in_file_thread([this_task = shared_from_this(), job = std::move(job)]() mutable{
+					// the repairs prefetched for the job replaced are never read
+					if (this_task->m_read_ahead)
+						this_task->m_read_ahead->release_repairs();
+					this_task->m_production = std::move(job);
+					this_task->produce_blocks();
+				});
+			}
+			
+			void files_delivery_session::file_send_task::collect_repairs(std::vector<std::uintmax_t>& repairs){
+				repairs.clear();
+				const auto end = m_repairs.size();
+				for (auto blk = m_repairs.find_next(0u, end); blk < end; blk = m_repairs.find_next(blk + 1, end))
+					repairs.push_back(blk);
+				m_repairs.clear();
+				if (m_repair_demand.empty())
+					return;
+				// the most wanted first, those equally wanted in file order
+				std::stable_sort(repairs.begin(), repairs.end(), [this](auto a, auto b){
+					return m_repair_demand[a] > m_repair_demand[b];
+				});
+				// the naks coming from now on count for the pass after this one
+				for (auto blk : repairs)
+					m_repair_demand[blk] = 0u;
+			}
+			
+			void files_delivery_session::file_send_task::collect_parity_repairs(std::vector<parity_repair>& parity_repairs){
+				parity_repairs.clear();
+				// a receiver not decoding the parity still needs the blocks themselves
+				const auto lacks_fec = [](const auto& receiver){
+					const auto status = receiver.second.current_status;
+					return not receiver.second.fec and not receiver.second.is_proxy and 
+						(status == session_context::receiver_properties::status::active or
+						status == session_context::receiver_properties::status::active_nak);
+				};
+				const auto decodable = std::none_of(m_context.receivers_properties.begin(), 
+					m_context.receivers_properties.end(), lacks_fec);
+				const auto codec = ya_uftp::detail::fec_codec{ m_context.fec->data_blocks, m_context.fec->parity_blocks };
+				const auto end = m_repairs.size();
+				for (auto blk = m_repairs.find_next(0u, end); blk < end; ){
+					const auto [first, group_end] = parity_group_of(blk);
+					auto lost = std::size_t(0u);
+					for (auto b = blk; b < group_end; b = m_repairs.find_next(b + 1, group_end))
+						lost++;
+					const auto rows = std::exchange(m_parity_demand[static_cast<std::size_t>(first)], std::uint8_t(0u));
+					// when one receiver lost all of them, the blocks themselves cost the same and need no decoding.
+					// the rows after the first pass ones are used once, a group repaired again gets its blocks
+					if (decodable and rows > 0u and rows < lost and not m_parity_repaired.test(first) and
+						codec.parity_count() + rows <= codec.max_parity_count()){
+						parity_repairs.push_back({first, group_end, codec.parity_count(), rows});
+						m_parity_repaired.set(first);
+						for (auto b = blk; b < group_end; b = m_repairs.find_next(b + 1, group_end))
+							m_repairs.reset(b);
+					}
+					blk = m_repairs.find_next(group_end, end);
+				}
+			}
+			
+			std::pair<std::uintmax_t, std::uintmax_t> 
+				files_delivery_session::file_send_task::parity_group_of(std::uintmax_t block_idx){
+				// a group never spans two sections, the last one of a section is shorter
+				const auto data_count = m_context.fec->data_blocks;
+				auto [sect_idx, blk_idx] = abs_block_idx_to_sect_blk(block_idx);
+				const auto first_blk = blk_idx / data_count * data_count;
+				const auto first = block_idx - (blk_idx - first_blk);
+				return {first, first + std::min<std::uintmax_t>(data_count, section_block_count(sect_idx) - first_blk)};
+			}
+			
+			std::size_t files_delivery_session::file_send_task::
+				record_naks(message::section_index section_idx, api::blob_view nak_map){
+				if (m_repairs.size() != m_block_count){
+					m_repairs.assign(m_block_count, false);
+					m_late_repairs.assign(m_block_count, false);
+					if (m_parent_session->m_repair_by_demand)
+						m_repair_demand.assign(static_cast<std::size_t>(m_block_count), 0u);
+					if (m_parent_session->m_repair_by_parity and m_context.fec){
+						m_parity_demand.assign(static_cast<std::size_t>(m_block_count), 0u);
+						m_late_parity_demand.assign(static_cast<std::size_t>(m_block_count), 0u);
+						m_parity_repaired.assign(m_block_count, false);
+					}
+				}
+				const auto first_block = sect_blk_to_abs_block_idx(section_idx, 0u);
+				const auto block_count = section_block_count(section_idx);
+				const auto interleaved = repairs_interleaved();
+				if (not interleaved){
+					// a pass takes its blocks when it starts, those lost meanwhile wait for the pass after it
+					auto& repairs = m_phase == phase::waiting_client_status ? m_repairs : m_late_repairs;
+					const auto lost = message::merge_lost_blocks(nak_map, block_count, repairs, first_block);
+					if (lost == 0u or (m_repair_demand.empty() and m_parity_demand.empty()))
+						return lost;
+				}
+				m_nak_blocks.clear();
+				message::extract_lost_blocks_ids(nak_map, m_nak_blocks);
+				if (not interleaved and not m_parity_demand.empty()){
+					// the parity repair of a group is as large as the most blocks of it a single receiver lost
+					auto& demand = m_phase == phase::waiting_client_status ? m_parity_demand : m_late_parity_demand;
+					const auto data_count = m_context.fec->data_blocks;
+					for (auto i = std::size_t(0u); i < m_nak_blocks.size() and m_nak_blocks[i] < block_count; ){
+						const auto group_blk = m_nak_blocks[i] / data_count * data_count;
+						auto lost = std::uint8_t(0u);
+						for (; i < m_nak_blocks.size() and m_nak_blocks[i] < block_count and 
+							m_nak_blocks[i] / data_count * data_count == group_blk; i++)
+							lost++;
+						auto& rows = demand[static_cast<std::size_t>(first_block + group_blk)];
+						rows = std::max(rows, lost);
+					}
+				}
+				auto lost = std::size_t(0u);
+				auto fresh = std::vector<std::uintmax_t>{};
+				for (auto blk_idx : m_nak_blocks){
+					if (blk_idx >= block_count)
+						break;
+					lost++;
+					const auto block = first_block + blk_idx;
+					if (not m_repair_demand.empty() and 
+						m_repair_demand[static_cast<std::size_t>(block)] < std::numeric_limits<std::uint16_t>::max())
+						m_repair_demand[static_cast<std::size_t>(block)]++;
+					// amid the first pass the block is resent right away, once until it is sent
+					if (interleaved and not m_late_repairs.test(block)){
+						m_late_repairs.set(block);
+						fresh.push_back(block);
+					}
+				}
+				if (not fresh.empty()){
+					m_worker.execute_in_file_thread([this_task = shared_from_this(), fresh = std::move(fresh)](){
+						// too late for the pass, they stay marked for the pass after it
+						auto& job = this_task->m_production;
+						if (job.sequential and not job.end_marked)
+							job.repairs.insert(job.repairs.end(), fresh.begin(), fresh.end());
+					});
+				}
+				return lost;
+			}
+			
+			void files_delivery_session::file_send_task::produce_blocks(){
+				auto& job = m_production;
+				while (not job.end_marked){
+					if (m_filled_blocks.full()){
+						// the consumer wakes us up once it takes a block, unless it took one meanwhile
+						m_producer_parked.store(true);
+						if (m_filled_blocks.full())
+							return;
+						m_producer_parked.store(false);
+						continue;
+					}
+					if (m_parity.sealed and m_parity.taken < m_parity.blocks.size()){
+						// the group is coded, its parity goes right after its last block
+						m_filled_blocks.try_emplace(take_parity());
 					}
-					else if (m_phase == phase::sending_lost){
-                        core::detail::progress_notification::get().post_progress(
-                            {id(), task::status::restransferring, m_local_path});
-						if (not m_current_retrans_block_iter){
-							m_current_retrans_block_iter = m_nak_records.cbegin();
+					else if (not job.sequential and job.parity_repaired < job.parity_repairs.size()){
+						// the group is read through, its parity blocks go out from the next round on
+						const auto& repair = job.parity_repairs[job.parity_repaired++];
+						if (auto reader = repair_reader(); reader){
+							m_prefetch_offsets.clear();
+							for (auto blk = repair.first; blk < repair.end and 
+								m_prefetch_offsets.size() < reader->repair_slots_free(); blk++)
+								m_prefetch_offsets.push_back(blk * m_context.block_size);
+							if (not m_prefetch_offsets.empty())
+								reader->prefetch(m_prefetch_offsets);
 						}
-						while (m_current_retrans_block_iter.value() != m_nak_records.cend()){
-							auto blk_idx = *m_current_retrans_block_iter.value();
-							
-							m_current_retrans_block_iter.value()++;
-							state_lock.unlock();
-							if (do_send_one_block(blk_idx)){
-								state_lock.lock();
-								if (m_phase == phase::sending_lost)
-									continue;
-								else
-									break;
-							}
-							else{
-								state_lock.lock();
-								blocked = true;
-								break;
-							}
+						open_parity_group(repair.first, repair.end, repair.first_row, repair.rows);
+						for (auto blk = repair.first; blk < repair.end; blk++)
+							add_to_parity(fill_block(blk));
+					}
+					else if (job.next == job.end and (not job.sequential or job.repairs.empty())){
+						m_filled_blocks.try_emplace(filled_block{job.end, nullptr, 0u, api::nullopt});
+						job.end_marked = true;
+					}
+					else if (job.sequential and job.repaired < job.repairs.size()){
+						// those not prefetched would be read through the sequential window
+						if (auto reader = repair_reader(); reader and (job.prefetched <= job.repaired or 
+							reader->repair_slots_free() >= read_ahead::max_repair_reads / 2))
+							prefetch_lost_blocks(*reader, job.repaired);
+						m_filled_blocks.try_emplace(fill_block(job.repairs[job.repaired++]));
+						if (job.repaired == job.repairs.size()){
+							job.repairs.clear();
+							job.repaired = 0u;
+							job.prefetched = 0u;
 						}
-						if (m_current_retrans_block_iter.value() == m_nak_records.cend()){
-							m_current_retrans_block_iter = api::nullopt;
-							
-							m_nak_records = std::move(m_not_yet_merged_nak_records);
-							m_not_yet_merged_nak_records.clear();
-							if (m_nak_records.empty()){
-								if (m_reach_eof){
-									m_phase = phase::waiting_client_status;
-									// reset all clients status to active
-									for (auto [rid, s] : m_context.receivers_properties){
-										if (not s.is_proxy)
-											s.current_status = session_context::receiver_properties::status::active;
-									}
-									if (not blocked){
-										m_worker.execute_in_net_thread([this_task = shared_from_this()](){
-											this_task->do_send_done();
-										});
-									}
-								}
-								else{
-									m_phase = phase::sending;
-									rewind = true;
-									continue;
-								}
-							}
-							else{
-								rewind = true;
-								continue;
+					}
+					else if (job.sequential){
+						auto block = fill_block(job.next++);
+						if (job.fec){
+							if (block.block_idx >= m_parity.end){
+								const auto [first, end] = parity_group_of(block.block_idx);
+								open_parity_group(first, end, 0u, job.fec->parity_count());
 							}
+							add_to_parity(block);
 						}
+						m_filled_blocks.try_emplace(std::move(block));
+					}
+					else{
+						// keep the batch of repair reads going ahead of the sending
+						if (auto reader = repair_reader(); reader and 
+							reader->repair_slots_free() >= read_ahead::max_repair_reads / 2)
+							prefetch_lost_blocks(*reader, job.next);
+						m_filled_blocks.try_emplace(fill_block(job.repairs[job.next++]));
+					}
+					if (m_consumer_idle.exchange(false)){
+						m_worker.execute_in_net_thread([this_task = shared_from_this()](){
+							this_task->send_filled_blocks();
+						});
 					}
 				}
 			}
 			
-			bool files_delivery_session::file_send_task::do_send_one_block(
-				std::uintmax_t block_idx, 
-				message_blob old_msg){
-				auto msg = std::move(old_msg);
+			files_delivery_session::file_send_task::filled_block
+				files_delivery_session::file_send_task::fill_block(std::uintmax_t block_idx){
+				constexpr auto header_size = message::header_template<message::file_seg>::size();
+				auto msg = m_worker.packet_pool().make(header_size + m_context.block_size);
+				const auto offset = m_context.block_size * block_idx;
+				if (auto mapping = mapped_source(); mapping){
+					// the block goes out from the page cache, only the header lives in the packet buffer
+					const auto length = std::min<std::uintmax_t>(m_context.block_size, mapping->size() - offset);
+					msg->resize(header_size);
+					msg->attach(mapping->data() + offset, length, m_mapping);
+					return {block_idx, std::move(msg), header_size + length, api::nullopt};
+				}
 				
-				if (not msg){
-					const auto msg_length = sizeof(message::protocol_header) + sizeof(message::file_seg) +
-						m_context.block_size;
-					msg = make_message_blob(msg_length);
-					auto uftp_hdr = new (msg->data()) message::protocol_header;
-					m_worker.setup_header(*uftp_hdr, message::role::file_seg);
-					auto fseg_hdr = new (msg->data() + sizeof(message::protocol_header)) message::file_seg;
-					fseg_hdr->header_length = sizeof(message::file_seg) / message::header_length_unit;
-					fseg_hdr->file_id = m_file_id;
-					auto [sect_idx, blk_idx] = abs_block_idx_to_sect_blk(block_idx);
-					fseg_hdr->section_idx = sect_idx;
-					fseg_hdr->block_idx = blk_idx;
-					
-					fseg_hdr->make_transfer_ready();
+				auto buf = api::blob_span{msg->data() + header_size, m_context.block_size};
+				if (auto reader = file_reader(); reader)
+					return {block_idx, std::move(msg), header_size + reader->read(offset, buf), api::nullopt};
+				if (not m_file_stream.is_open())
+					m_file_stream.open(m_local_path.string(), std::ios_base::in | std::ios_base::binary);
+				if (m_file_stream.tellg() != offset){
+					if (m_file_stream.eof())
+						m_file_stream.clear();
+					m_file_stream.seekg(offset); 
 				}
+				m_file_stream.read(reinterpret_cast<char*>(buf.data()), buf.size());
+				return {block_idx, std::move(msg), header_size + m_file_stream.gcount(), api::nullopt};
+			}
+			
+			void files_delivery_session::file_send_task::open_parity_group(std::uintmax_t first, std::uintmax_t end, 
+				std::size_t first_row, std::size_t rows){
+				constexpr auto header_size = message::header_template<message::file_parity>::size();
+				auto& group = m_parity;
+				group.first = first;
+				group.end = end;
+				group.first_row = first_row;
+				group.blocks.clear();
+				group.payloads.clear();
+				for (auto k = std::size_t(0u); k < rows; k++){
+					group.blocks.push_back(m_worker.packet_pool().make(header_size + m_context.block_size, 0u));
+					group.payloads.push_back(group.blocks.back()->data() + header_size);
+				}
+				group.sealed = false;
+				group.taken = 0u;
+			}
+			
+			void files_delivery_session::file_send_task::add_to_parity(const filled_block& block){
+				constexpr auto header_size = message::header_template<message::file_seg>::size();
+				auto& group = m_parity;
+				// a mapped block is attached to the FILE_SEG, not copied into it
+				const auto mapping = mapped_source();
+				const auto data = mapping ? mapping->data() + m_context.block_size * block.block_idx : block.msg->data() + header_size;
+				m_production.fec->encode(static_cast<std::size_t>(block.block_idx - group.first), 
+					api::blob_view{data, block.length - header_size}, group.payloads.data(), group.first_row, group.payloads.size());
+				group.sealed = block.block_idx + 1u == group.end;
+			}
+			
+			files_delivery_session::file_send_task::filled_block
+				files_delivery_session::file_send_task::take_parity(){
+				const auto slot = m_parity.taken++;
+				return {m_parity.first, std::move(m_parity.blocks[slot]), 
+					message::header_template<message::file_parity>::size() + m_context.block_size, 
+					static_cast<std::uint8_t>(m_parity.first_row + slot)};
+			}
+			
+			void files_delivery_session::file_send_task::send_filled_blocks(){
+				while (true){
+					// the blocks of the sections to ask about are all sent
+					if (m_sent_through >= m_feedback_block and not m_section_done_after)
+						m_section_done_after = m_blocks_in_flight;
+					if (m_section_done_after == std::size_t(0u)){
+						m_section_done_after = api::nullopt;
+						if (not do_send_section_done())
+							return;
+						continue;
+					}
+					auto block = m_filled_blocks.front();
+					if (not block){
+						// the producer posts us again once it fills a block, unless it filled one meanwhile
+						m_consumer_idle.store(true);
+						if (m_filled_blocks.empty() or not m_consumer_idle.exchange(false))
+							return;
+						continue;
+					}
+					auto next = std::move(*block);
+					m_filled_blocks.pop();
+					if (m_producer_parked.exchange(false)){
+						m_worker.execute_in_file_thread([this_task = shared_from_this()](){
+							this_task->produce_blocks();
+						});
+					}
+					if (not next.msg){
+						// DONE must not overtake the last blocks of the pass
+						m_pass_produced = true;
+						if (m_blocks_in_flight == 0u){
+							m_pass_produced = false;
+							on_production_finished();
+						}
+					}
+					else if (not do_send_one_block(std::move(next)))
+						return;
+				}
+			}
+			
+			void files_delivery_session::file_send_task::on_production_finished(){
+				// the DONE of the pass asks about the sections left
+				m_section_done_after = api::nullopt;
+				// the naks received during the pass are resent by the next one
+				std::swap(m_repairs, m_late_repairs);
+				std::swap(m_parity_demand, m_late_parity_demand);
+				if (m_phase == phase::sending){
+					m_phase = phase::waiting_client_status;
+					do_send_done();
+				}
+				else if (m_phase == phase::sending_lost){
+					if (m_repairs.none()){
+						m_phase = phase::waiting_client_status;
+						// reset all clients status to active
+						for (auto [rid, s] : m_context.receivers_properties){
+							if (not s.is_proxy)
+								s.current_status = session_context::receiver_properties::status::active;
+						}
+						do_send_done();
+					}
+					else
+						start_production();
+				}
+			}
+			
+			bool files_delivery_session::file_send_task::do_send_one_block(filled_block block){
+				auto& msg = block.msg;
+				if (block.parity_idx)
+					stamp_parity_header(block);
 				else{
-					auto uftp_hdr = reinterpret_cast<message::protocol_header *>(msg->data());
-					uftp_hdr->sequence_number = boost::endian::native_to_big(m_context.msg_seq_num++);
-					auto fseg_hdr = reinterpret_cast<message::file_seg*>(msg->data() + sizeof(message::protocol_header));
-					fseg_hdr->file_id = m_file_id;
-					auto [sect_idx, blk_idx] = abs_block_idx_to_sect_blk(block_idx);
-					assert(block_idx == sect_blk_to_abs_block_idx(sect_idx, blk_idx));
-					fseg_hdr->section_idx = sect_idx;
-					fseg_hdr->block_idx = blk_idx;
+					if (not m_file_seg_template){
+						auto& tmpl = m_file_seg_template.emplace();
+						new (&tmpl.uftp_header()) message::protocol_header;
+						m_worker.setup_header_template(tmpl.uftp_header(), message::role::file_seg);
+						auto& fseg_hdr = *new (&tmpl.header()) message::file_seg;
+						fseg_hdr.header_length = sizeof(message::file_seg) / message::header_length_unit;
+						fseg_hdr.file_id = m_file_id;
+						fseg_hdr.section_idx = 0u;
+						fseg_hdr.block_idx = 0u;
+						fseg_hdr.make_transfer_ready();
+					}
+					auto fseg_hdr = m_file_seg_template->stamp(msg->data(), m_context.msg_seq_num++, m_worker.quantized_grtt());
+					auto [sect_idx, blk_idx] = locate_block(m_send_cursor, block.block_idx);
+					assert(block.block_idx == sect_blk_to_abs_block_idx(sect_idx, blk_idx));
+					fseg_hdr->section_idx = boost::endian::native_to_big(sect_idx);
+					fseg_hdr->block_idx = boost::endian::native_to_big(blk_idx);
 					
-					fseg_hdr->make_transfer_ready();
-				}
-				
-				auto write_data = [this, block_idx]
-					(api::blob_span buf) -> std::size_t {
-					assert(buf.size() == m_context.block_size);
-					if (not m_file_stream.is_open())
-						m_file_stream.open(m_local_path.string(), std::ios_base::in | std::ios_base::binary);
-					auto pos = m_context.block_size * block_idx;
-					if (m_file_stream.tellg() != pos){
-						if (m_file_stream.eof())
-							m_file_stream.clear();
-						m_file_stream.seekg(pos); 
-					}
-					m_file_stream.read(reinterpret_cast<char*>(buf.data()), buf.size());
-					return m_file_stream.gcount();
-				};
-				
-				auto next_step = [this_task = shared_from_this(), old_msg = msg]
-					(const boost::system::error_code ec, std::size_t bytes_sent){
-						if (ec){
-							this_task->m_worker.cancel_all_jobs();
-							this_task->m_parent_session->on_file_send_error(files_delivery_session::visa{});
+					if (m_phase == phase::sending){
+						m_sent_through = std::max(m_sent_through, block.block_idx + 1u);
+						// the block is on its way again, a NAK from now on asks for it anew
+						if (repairs_interleaved() and m_late_repairs.size() > 0u){
+							m_late_repairs.reset(block.block_idx);
+							if (not m_repair_demand.empty())
+								m_repair_demand[static_cast<std::size_t>(block.block_idx)] = 0u;
 						}
-					};
+					}
+				}
 				
-				auto [sent, msg_len] = m_worker.send_packet(msg, m_context.private_mcast_dest, std::move(write_data), 
-					api::nullopt, next_step);
+				auto completion = std::shared_ptr<worker::send_completion>{shared_from_this()};
+				m_blocks_in_flight++;
+				auto [sent, msg_len] = m_worker.send_packet(msg, m_context.private_mcast_dest, nullptr, 
+					block.length, completion);
 				if (not sent){
 					assert(not m_blocked_msg_args and not m_blocked_task);
-					m_blocked_msg_args.emplace(msg, msg_len, 
-							std::ref(m_context.private_mcast_dest), next_step);
+					m_blocked_msg_args.emplace(std::move(msg), block.length, 
+							std::ref(m_context.private_mcast_dest), std::move(completion));
 					m_blocked_task = [this_task = shared_from_this()](){
-						this_task->m_worker.execute_in_file_thread([this_task]()
-						{ this_task->do_transfer();});
+						this_task->send_filled_blocks();
 					};
 				}
 				return sent;
 			}
 			
+			void files_delivery_session::file_send_task::stamp_parity_header(const filled_block& block){
+				if (not m_file_parity_template){
+					auto& tmpl = m_file_parity_template.emplace();
+					new (&tmpl.uftp_header()) message::protocol_header;
+					m_worker.setup_header_template(tmpl.uftp_header(), message::role::file_parity);
+					auto& parity_hdr = *new (&tmpl.header()) message::file_parity;
+					parity_hdr.header_length = sizeof(message::file_parity) / message::header_length_unit;
+					parity_hdr.file_id = m_file_id;
+					parity_hdr.section_idx = 0u;
+					parity_hdr.first_block_idx = 0u;
+					parity_hdr.data_blocks = 0u;
+					parity_hdr.parity_idx = 0u;
+					parity_hdr.make_transfer_ready();
+				}
+				
+				auto parity_hdr = m_file_parity_template->stamp(block.msg->data(), m_context.msg_seq_num++, m_worker.quantized_grtt());
+				auto [sect_idx, blk_idx] = abs_block_idx_to_sect_blk(block.block_idx);
+				parity_hdr->section_idx = boost::endian::native_to_big(sect_idx);
+				parity_hdr->first_block_idx = boost::endian::native_to_big(blk_idx);
+				parity_hdr->data_blocks = static_cast<std::uint8_t>(std::min<std::size_t>(m_context.fec->data_blocks, 
+					section_block_count(sect_idx) - blk_idx));
+				parity_hdr->parity_idx = *block.parity_idx;
+			}
+			
 			bool files_delivery_session::file_send_task::do_send_done(message_blob old_msg){
 				auto msg = std::move(old_msg);
-				auto sect_idx = 0u;
-				if (not msg){
-					auto msg_length = sizeof(message::protocol_header) + sizeof(message::done) + m_context.block_size;
-					msg = make_message_blob(msg_length, 0u);
-					auto uftp_hdr = new (msg->data()) message::protocol_header;
-					m_worker.setup_header(*uftp_hdr, message::role::done);
-					auto done_hdr = new (msg->data() + sizeof(message::protocol_header)) message::done;
-					done_hdr->header_length = sizeof(message::done) / message::header_length_unit;
-					done_hdr->file_id = m_file_id;
-					done_hdr->section_idx = m_section_count > 0u ? (m_section_count - 1) : 0u;
-					sect_idx = done_hdr->section_idx;
-					done_hdr->make_transfer_ready();
-				}
-				else{
-					auto uftp_hdr = reinterpret_cast<message::protocol_header*>(msg->data());
-					uftp_hdr->sequence_number = boost::endian::native_to_big(m_context.msg_seq_num++);
-					auto done_hdr = reinterpret_cast<message::done*>(msg->data() + sizeof(message::protocol_header));
-					sect_idx = boost::endian::big_to_native(done_hdr->section_idx);
-				}
+				if (not msg)
+					msg = m_worker.packet_pool().make(message::header_template<message::done>::size() + m_context.block_size, 0u);
+				prepare_done_template();
+				// the grtt may have been refined since the last round
+				m_done_template->stamp(msg->data(), m_context.msg_seq_num++, m_worker.quantized_grtt());
 				
 				auto only_active = [](session_context::receiver_properties& s) {
 					return s.current_status == session_context::receiver_properties::status::active or 
@@ -395,7 +653,7 @@ namespace ya_uftp{
 				};
 				
 				core::detail::progress_notification::get().post_progress({
-					id(), task::status::sending_done_nofitication, m_local_path});
+					id(), task::status::sending_done_nofitication, m_local_path, m_worker.statistics()});
 				auto [all_sent, bytes_sent] = m_worker.send_to_targeted_receivers(msg, m_context.private_mcast_dest, 
 					std::move(only_active));
 				if (all_sent)
@@ -407,6 +665,54 @@ namespace ya_uftp{
 				return all_sent;
 			}
 			
+			bool files_delivery_session::file_send_task::do_send_section_done(){
+				const auto interval = m_parent_session->m_section_feedback_interval;
+				auto msg = m_worker.packet_pool().make(message::header_template<message::done>::size() + m_context.block_size, 0u);
+				prepare_done_template();
+				auto done_hdr = m_done_template->stamp(msg->data(), m_context.msg_seq_num++, m_worker.quantized_grtt());
+				done_hdr->section_idx = boost::endian::native_to_big(m_feedback_section);
+				done_hdr->section_count = boost::endian::native_to_big(interval);
+				
+				// the last section is asked about by the DONE at the end of the pass
+				if (m_feedback_section + interval + 1u < m_section_count){
+					m_feedback_section += interval;
+					m_feedback_block = sect_blk_to_abs_block_idx(m_feedback_section + 1u, 0u);
+				}
+				else
+					m_feedback_block = std::numeric_limits<std::uintmax_t>::max();
+				
+				auto only_active = [](session_context::receiver_properties& s) {
+					return s.current_status == session_context::receiver_properties::status::active or 
+						s.current_status == session_context::receiver_properties::status::active_nak;
+				};
+				auto [all_sent, bytes_sent] = m_worker.send_to_targeted_receivers(msg, m_context.private_mcast_dest, 
+					std::move(only_active));
+				if (not all_sent){
+					assert(not m_blocked_task);
+					m_blocked_task = [this_task = shared_from_this()](){
+						this_task->send_filled_blocks();
+					};
+				}
+				return all_sent;
+			}
+			
+			void files_delivery_session::file_send_task::prepare_done_template(){
+				if (m_done_template)
+					return;
+				auto& tmpl = m_done_template.emplace();
+				new (&tmpl.uftp_header()) message::protocol_header;
+				m_worker.setup_header_template(tmpl.uftp_header(), message::role::done);
+				auto& done_hdr = *new (&tmpl.header()) message::done;
+				done_hdr.header_length = sizeof(message::done) / message::header_length_unit;
+				done_hdr.file_id = m_file_id;
+				done_hdr.section_idx = m_section_count > 0u ? (m_section_count - 1) : 0u;
+				done_hdr.make_transfer_ready();
+			}
+			
+			bool files_delivery_session::file_send_task::repairs_interleaved() const{
+				return m_phase == phase::sending and m_parent_session->m_section_feedback_interval > 0u;
+			}
+			
 			void files_delivery_session::file_send_task::
 				on_wait_receivers_status_end(message_blob old_done_msg){
 				auto blocks_lost = false;
@@ -423,12 +729,8 @@ namespace ya_uftp{
 					if (not all_members_responsed)
 						do_send_done(std::move(old_done_msg));
 					else if (blocks_lost){
-						std::unique_lock state_lock(m_state_mutex);
 						m_phase = phase::sending_lost;
-						state_lock.unlock();
-						m_worker.execute_in_file_thread([this_task = shared_from_this()](){
-							this_task->do_transfer();
-						});
+						start_production();
 					}
 					else{
 						m_worker.cancel_all_jobs();
@@ -455,12 +757,8 @@ namespace ya_uftp{
 						return;
 					}
 					if (blocks_lost){
-						std::unique_lock state_lock(m_state_mutex);
 						m_phase = phase::sending_lost;
-						state_lock.unlock();
-						m_worker.execute_in_file_thread([this_task = shared_from_this()](){
-							this_task->do_transfer();
-						});
+						start_production();
 					}
 					else {
 						m_worker.cancel_all_jobs();
@@ -469,17 +767,77 @@ namespace ya_uftp{
 				}
 			}
 			
+			read_ahead* files_delivery_session::file_send_task::file_reader(){
+				if (not m_read_ahead_tried){
+					m_read_ahead_tried = true;
+					if (auto& engine = m_parent_session->m_read_engine; engine)
+						m_read_ahead = read_ahead::open(*engine, m_local_path, m_file_size, m_context.block_size,
+							m_parent_session->m_read_ahead_chunk_size, m_parent_session->m_read_ahead_window);
+				}
+				return m_read_ahead.get();
+			}
+			
+			const mapped_file* files_delivery_session::file_send_task::mapped_source(){
+				if (not m_mapping_tried){
+					m_mapping_tried = true;
+					if (m_parent_session->m_zero_copy_send)
+						m_mapping = mapped_file::map(m_local_path, m_file_size);
+				}
+				return m_mapping.get();
+			}
+			
+			read_ahead* files_delivery_session::file_send_task::repair_reader(){
+				// fill_block never reads what it copies from the mapping, the slots prefetched would stay taken
+				if (mapped_source())
+					return nullptr;
+				return file_reader();
+			}
+			
+			void files_delivery_session::file_send_task::prefetch_lost_blocks(read_ahead& reader, std::size_t next){
+				auto& job = m_production;
+				const auto free_slots = reader.repair_slots_free();
+				job.prefetched = std::max<std::size_t>(job.prefetched, next);
+				m_prefetch_offsets.clear();
+				for (; job.prefetched < job.repairs.size() and m_prefetch_offsets.size() < free_slots; job.prefetched++)
+					m_prefetch_offsets.push_back(job.repairs[job.prefetched] * m_context.block_size);
+				if (not m_prefetch_offsets.empty())
+					reader.prefetch(m_prefetch_offsets);
+			}
+			
 			void files_delivery_session::file_send_task::on_worker_bucket_freed(){
 				if (m_blocked_msg_args){
 					auto [msg, len, dest, handler] = m_blocked_msg_args.value();
 					auto [sent, sent_len] = m_worker.send_packet(msg, dest, nullptr, len, std::move(handler));
-					assert(sent and sent_len == len);
+					// the queue has been filled up again since the worker looked, wait for the next release
+					if (not sent)
+						return;
+					assert(sent_len == len);
 					m_blocked_msg_args = api::nullopt;
 				}
-				if (m_blocked_task){
-					auto task_copy = m_blocked_task;
-					m_blocked_task = nullptr;
+				auto task_copy = std::move(m_blocked_task);
+				m_blocked_task = nullptr;
+				if (task_copy)
 					task_copy();
+			}
+			
+			void files_delivery_session::file_send_task::on_packet_sent(const boost::system::error_code ec, std::size_t bytes_sent){
+				if (ec){
+					m_worker.cancel_all_jobs();
+					m_parent_session->on_file_send_error(files_delivery_session::visa{});
+				}
+				else{
+					--m_blocks_in_flight;
+					if (m_section_done_after and m_section_done_after.value() > 0u and --m_section_done_after.value() == 0u){
+						// the blocked sending resumes through send_filled_blocks() by itself
+						m_worker.execute_in_net_thread([this_task = shared_from_this()](){
+							if (not this_task->m_blocked_task and this_task->m_section_done_after == std::size_t(0u))
+								this_task->send_filled_blocks();
+						});
+					}
+					if (m_blocks_in_flight == 0u and m_pass_produced){
+						m_pass_produced = false;
+						on_production_finished();
+					}
 				}
 			}
 			
@@ -510,7 +868,6 @@ namespace ya_uftp{
 			
 			void files_delivery_session::file_send_task::
 				on_file_info_ack_received(api::blob_span packet, message::member_id source_id){
-				std::lock_guard state_lock(m_state_mutex);
 				if (m_phase == phase::announcing){
 					if (auto finfo_ack = message::file_info_ack::parse_packet(packet); finfo_ack){
 						if (finfo_ack->main.id == m_file_id){
@@ -555,27 +912,18 @@ namespace ya_uftp{
 				if (auto client_status = message::status::parse_packet(packet); client_status){
 					if (client_status->main.file_id == m_file_id){
 						if (auto rit = m_context.receivers_properties.find(receiver_id); 
-							rit != m_context.receivers_properties.end() and rit->second.current_status != session_context::receiver_properties::status::done){
+							rit != m_context.receivers_properties.end() and rit->second.current_status != session_context::receiver_properties::status::done and
+							client_status->main.section_idx < m_section_count){
 							
-							auto nak_blocks = message::extract_lost_blocks_ids(client_status->nak_map);
-							if (nak_blocks.empty()){
+							if (record_naks(client_status->main.section_idx, client_status->nak_map) == 0u){
 								std::cout << "Received STATUS without lost from " << std::hex << receiver_id << std::dec << '\n'; 
 							}
 							else{
-								if (rit->second.current_status != session_context::receiver_properties::status::done){
+								// amid the first pass the losses are resent right away, the receiver is asked again at its end
+								if (rit->second.current_status != session_context::receiver_properties::status::done and 
+									not repairs_interleaved()){
 									rit->second.current_status = session_context::receiver_properties::status::active_nak;
 									std::cout << "Received STATUS with lost from " << std::hex << receiver_id << std::dec << '\n'; 
-									std::lock_guard state_lock(m_state_mutex);
-									if (m_phase == phase::waiting_client_status){
-										for (auto blk_idx : nak_blocks){
-											m_nak_records.emplace(sect_blk_to_abs_block_idx(client_status->main.section_idx, blk_idx));
-										}
-									}
-									else{
-										for (auto blk_idx : nak_blocks){
-											m_not_yet_merged_nak_records.emplace(sect_blk_to_abs_block_idx(client_status->main.section_idx, blk_idx));
-										}
-									}
 								}
 							}
 						}
@@ -585,7 +933,6 @@ namespace ya_uftp{
 			
 			void files_delivery_session::file_send_task::
 				on_complete_msg_received(api::blob_span packet, message::member_id receiver_id){
-				std::lock_guard state_lock(m_state_mutex);
 				if (m_phase == phase::waiting_client_status or
 					m_phase == phase::announcing){
 					if (auto receiver_complete = message::complete::parse_packet(packet); receiver_complete){
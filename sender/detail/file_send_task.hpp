@@ -4,8 +4,15 @@
 
 #include "detail/file_transfer_base.hpp"
 #include "sender/detail/session_context.hpp"
+#include "sender/detail/read_ahead.hpp"
+#include "sender/detail/mapped_file.hpp"
+#include "detail/spsc_ring.hpp"
+#include "detail/block_bitmap.hpp"
+#include "detail/fec.hpp"
 #include <fstream>
-#include <mutex>
+#include <atomic>
+#include <limits>
+#include <vector>
 
 namespace ya_uftp{
 	namespace sender{
@@ -13,7 +20,8 @@ namespace ya_uftp{
 			class files_delivery_session::file_send_task : 
 				public std::enable_shared_from_this<file_send_task>, 
 				public ya_uftp::detail::file_transfer_base,
-				public worker::employer {
+				public worker::employer,
+				public worker::send_completion {
 				struct private_ctor_tag{};
 				enum class phase {
 					announcing,
@@ -23,27 +31,117 @@ namespace ya_uftp{
 					complete
 				};
 				
+				// a block read by the file thread, waiting for the net thread to stamp and send it
+				struct filled_block{
+					std::uintmax_t	block_idx;
+					// nullptr marks the end of the pass
+					message_blob	msg;
+					std::size_t		length;
+					// a parity block of the group starting at block_idx
+					api::optional<std::uint8_t>	parity_idx;
+				};
+				// a group of lost blocks resent as rows of fresh parity blocks
+				struct parity_repair{
+					std::uintmax_t					first;
+					std::uintmax_t					end;
+					std::uint8_t					first_row;
+					std::uint8_t					rows;
+				};
+				// the blocks one pass produces, owned by the file thread
+				struct production_job{
+					bool							sequential = true;
+					// the lost blocks to resend, those of the whole pass when not sequential. otherwise those
+					// the net thread hands in amid the pass, they go ahead of the next block in order
+					std::vector<std::uintmax_t>		repairs;
+					// the repairs before it are produced, when sequential
+					std::size_t						repaired = 0u;
+					std::uintmax_t					next = 0u;
+					std::uintmax_t					end = 0u;
+					// the repairs before it have their reads issued
+					std::size_t						prefetched = 0u;
+					bool							end_marked = true;
+					// codes the parity of the sequential blocks, when any receiver takes it, or the parity repairs
+					api::optional<ya_uftp::detail::fec_codec>	fec;
+					// coded ahead of the lost blocks, when not sequential
+					std::vector<parity_repair>		parity_repairs;
+					std::size_t						parity_repaired = 0u;
+				};
+				// the parity blocks of the group the sequential blocks are in
+				struct parity_group{
+					std::uintmax_t					first = 0u;
+					std::uintmax_t					end = 0u;
+					std::vector<message_blob>		blocks;
+					std::vector<std::uint8_t*>		payloads;
+					// the row of the first parity block
+					std::size_t						first_row = 0u;
+					// all of the data blocks are coded, the parity blocks from taken on are to be sent
+					bool							sealed = false;
+					std::size_t						taken = 0u;
+				};
+				static constexpr std::size_t filled_blocks_capacity = 256u;
+				
 				worker&											m_worker;
 				session_context&								m_context;
 				api::fs::path									m_local_path;
 				api::fs::path									m_remote_path;
 				message::file_id_type							m_file_id;
-				std::uintmax_t									m_current_block_idx = 0u;
-				std::ifstream									m_file_stream;
 				std::shared_ptr<files_delivery_session>			m_parent_session;
 				
-				bool											m_reach_eof = false;
-						
-				std::set<std::uintmax_t>						m_nak_records;
-				api::optional<std::set<std::uintmax_t>::const_iterator>		m_current_retrans_block_iter;
-				// when in sending_lost phase, we use iterator to resend losted block one by one, 
-				// yet we should continue remember any naks received, so here it is
-				std::set<std::uintmax_t>						m_not_yet_merged_nak_records;
+				// the phase and the naks are only touched in the net thread, 
+				// the file thread learns a new pass by the job posted to it.
+				// the blocks the next pass resends, the NAK maps of all the receivers or-ed in. sized on the first nak
+				ya_uftp::detail::block_bitmap					m_repairs;
+				// naks received while a pass is going on, they are resent by the pass after it
+				ya_uftp::detail::block_bitmap					m_late_repairs;
+				// how many receivers lost each block since it was last resent, empty unless repairing by demand
+				std::vector<std::uint16_t>						m_repair_demand;
+				// at the first block of each group, the most blocks of the group a receiver lost, for the next pass and
+				// the pass after it like the repairs. empty unless repairing by parity
+				std::vector<std::uint8_t>						m_parity_demand;
+				std::vector<std::uint8_t>						m_late_parity_demand;
+				// the groups repaired by parity already, at their first block. the next repairs resend their blocks
+				ya_uftp::detail::block_bitmap					m_parity_repaired;
+				// the lost blocks of the STATUS at hand, kept to reuse its storage
+				std::vector<message::block_index>				m_nak_blocks;
+				// when first sending, the next DONE asks about the sections up to m_feedback_section once the blocks 
+				// before m_feedback_block are sent, which is never when no section DONE is due
+				message::section_index							m_feedback_section = 0u;
+				std::uintmax_t									m_feedback_block = std::numeric_limits<std::uintmax_t>::max();
+				// the first pass has sent the blocks before it
+				std::uintmax_t									m_sent_through = 0u;
+				// the blocks handed to the worker ahead of the section DONE due, which goes on the control lane 
+				// and would overtake them. it is sent once they are all gone, i.e. at 0
+				api::optional<std::size_t>						m_section_done_after;
 				std::uint32_t									m_rounds = 0u;
-				std::mutex										m_state_mutex;
 				phase											m_phase = phase::announcing;
 				api::optional<worker::send_args>				m_blocked_msg_args;
 				std::function<void()>							m_blocked_task;
+				// headers are built once per task, each message only patches the sequence number, grtt and position
+				api::optional<message::header_template<message::file_seg>>	m_file_seg_template;
+				api::optional<message::header_template<message::done>>		m_done_template;
+				api::optional<message::header_template<message::file_parity>>	m_file_parity_template;
+				block_cursor									m_send_cursor;
+				// FILE_SEGs handed to the worker but not to the kernel yet
+				std::size_t										m_blocks_in_flight = 0u;
+				// the end of the pass is taken from the ring, waiting for the blocks in flight
+				bool											m_pass_produced = false;
+				
+				ya_uftp::detail::spsc_ring<filled_block>		m_filled_blocks{filled_blocks_capacity};
+				// set by the side going to sleep, whoever clears it posts the wake up
+				alignas(ya_uftp::detail::cache_line_size) std::atomic<bool>	m_consumer_idle = true;
+				alignas(ya_uftp::detail::cache_line_size) std::atomic<bool>	m_producer_parked = false;
+				
+				// below are owned by the file thread
+				alignas(ya_uftp::detail::cache_line_size) production_job	m_production;
+				parity_group									m_parity;
+				std::ifstream									m_file_stream;
+				// nullptr when the session has no read engine, the blocks are then read from m_file_stream
+				std::unique_ptr<read_ahead>						m_read_ahead;
+				bool											m_read_ahead_tried = false;
+				std::vector<std::uintmax_t>						m_prefetch_offsets;
+				// the blocks are attached to the FILE_SEG straight from the mapping when zero copy send is on
+				std::shared_ptr<const mapped_file>				m_mapping;
+				bool											m_mapping_tried = false;
 			public:
 				file_send_task(const api::fs::path& local_path, 
 					const api::fs::path& remote_path, 
@@ -60,15 +158,46 @@ namespace ya_uftp{
 				void run();
 				void on_worker_bucket_freed() override;
 				void on_message_received(message::validated_packet valid_packet) override;
+				// every FILE_SEG of the task completes here
+				void on_packet_sent(const boost::system::error_code ec, std::size_t bytes_sent) override;
 				~file_send_task();
 			private:
                 std::uint32_t id() const;
 				void do_send_fileinfo();
-				void do_transfer();
-				
-				bool do_send_one_block(std::uintmax_t block_idx, 
-					message_blob old_msg = nullptr);
+				// net thread, hands the pass of the current phase to the file thread
+				void start_production();
+				// the blocks of m_repairs in the order to resend them, which clears it
+				void collect_repairs(std::vector<std::uintmax_t>& repairs);
+				// take out of m_repairs the groups cheaper to repair by parity than by resending their blocks
+				void collect_parity_repairs(std::vector<parity_repair>& parity_repairs);
+				// the first and the end block of the group the block is in
+				std::pair<std::uintmax_t, std::uintmax_t> parity_group_of(std::uintmax_t block_idx);
+				// or the NAK map into the repairs of the pass it is for, return the count of the blocks it marks lost
+				std::size_t record_naks(message::section_index section_idx, api::blob_view nak_map);
+				void on_production_finished();
+				void send_filled_blocks();
+				bool do_send_one_block(filled_block block);
+				void stamp_parity_header(const filled_block& block);
 				bool do_send_done(message_blob old_msg = nullptr);
+				// the DONE amid the first pass, false when it is blocked and the sending resumes once it goes
+				bool do_send_section_done();
+				void prepare_done_template();
+				// the lost blocks are resent amid the first pass rather than by the passes after it
+				bool repairs_interleaved() const;
+				
+				// file thread
+				void produce_blocks();
+				filled_block fill_block(std::uintmax_t block_idx);
+				// code the sequential block into the parity of its group
+				void open_parity_group(std::uintmax_t first, std::uintmax_t end, std::size_t first_row, std::size_t rows);
+				void add_to_parity(const filled_block& block);
+				filled_block take_parity();
+				read_ahead* file_reader();
+				const mapped_file* mapped_source();
+				// the reader to prefetch the repairs through, none when the blocks are copied from the mapping
+				read_ahead* repair_reader();
+				// issue the reads of the repairs from the one at next on
+				void prefetch_lost_blocks(read_ahead& reader, std::size_t next);
 				
 				//void schedule_next_round_resend(message_blob msg);
 				
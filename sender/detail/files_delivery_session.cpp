@@ -1,6 +1,7 @@
 #include "sender/detail/files_delivery_session.hpp"
 #include "sender/detail/worker.hpp"
 #include "sender/detail/file_send_task.hpp"
+#include "sender/detail/read_ahead.hpp"
 
 #include "detail/progress_notification.hpp"
 
@@ -20,7 +21,14 @@ namespace ya_uftp{
 				: m_worker(std::make_unique<worker>(net_io_ctx, file_io_ctx, params)), 
 				m_context(m_worker->get_context()),
 				m_files(std::move(params.files)),
-				m_base_dir(std::move(params.base_dir))
+				m_base_dir(std::move(params.base_dir)),
+				m_read_engine(read_engine::create(params.file_read_backend, params.read_ahead_window + read_ahead::max_repair_reads)),
+				m_read_ahead_chunk_size(params.read_ahead_chunk_size),
+				m_read_ahead_window(params.read_ahead_window),
+				m_zero_copy_send(params.zero_copy_send),
+				m_repair_by_demand(params.repair_by_demand),
+				m_repair_by_parity(params.repair_by_parity),
+				m_section_feedback_interval(params.section_feedback_interval.value_or(0u))
             {
 					// ToDo: consider accept user specify task_id to support resumable task
 					if (params.allowed_clients){
@@ -64,9 +72,10 @@ namespace ya_uftp{
 				if (body_length > m_context.block_size)
 					body_length = m_context.block_size;
 				auto target_is_v4 = m_context.public_mcast_dest.address().is_v4();
+				const auto ext_length = m_context.fec ? sizeof(message::extension::fec_info) : 0u;
 				const auto msg_length = sizeof(message::protocol_header) + sizeof(message::announce) +
 					(target_is_v4 ? 8 : 32) + // public + private mcast ip
-					body_length;
+					ext_length + body_length;
 
 				auto msg = make_message_blob(msg_length);
 
@@ -103,6 +112,13 @@ namespace ya_uftp{
 					auto priv_mcast_v6_addr = m_context.private_mcast_dest.address().to_v6().to_bytes();
 					std::copy(priv_mcast_v6_addr.begin(), priv_mcast_v6_addr.end(), priv_mcast_addr_field);
 				}
+				if (m_context.fec) {
+					auto fec_ext = new (msg->data() + sizeof(message::protocol_header) + sizeof(message::announce) + 
+						(target_is_v4 ? 8 : 32)) message::extension::fec_info;
+					fec_ext->length = sizeof(message::extension::fec_info) / message::header_length_unit;
+					fec_ext->data_blocks = m_context.fec->data_blocks;
+					fec_ext->parity_blocks = m_context.fec->parity_blocks;
+				}
 				// ToDo: add support for closed group clients
 
 				announce_hdr->make_transfer_ready();
@@ -111,7 +127,7 @@ namespace ya_uftp{
 
 				//std::cout << "Do announcing the " << m_rounds << "th times\n";
                 core::detail::progress_notification::get().post_progress(
-                    {id(), task::status::announcing, {}});
+                    {id(), task::status::announcing, {}, m_worker->statistics()});
 				auto after_sent = [this_session = shared_from_this()]
 					(const boost::system::error_code ec, std::size_t bytes_sent){
 					if (this_session->m_rounds++ < this_session->m_context.robust_factor){
@@ -179,7 +195,7 @@ namespace ya_uftp{
 									return need_include;
 								};
 					
-					core::detail::progress_notification::get().post_progress({id(), task::status::confirming_registration, {}});
+					core::detail::progress_notification::get().post_progress({id(), task::status::confirming_registration, {}, m_worker->statistics()});
 					auto [success, bytes_sent] = m_worker->send_to_targeted_receivers(
 						msg, m_context.private_mcast_dest, only_registered);
 					all_sent = success;
@@ -245,6 +261,9 @@ namespace ya_uftp{
 							iter->second.rtt = message::calculate_rtt(
 								reg_msg->main.msg_timestamp_usecs_high, 
 								reg_msg->main.msg_timestamp_usecs_low);
+							iter->second.fec = m_context.fec and reg_msg->fec and 
+								reg_msg->fec->data_blocks == m_context.fec->data_blocks and 
+								reg_msg->fec->parity_blocks == m_context.fec->parity_blocks;
 						}
 						else{
 							auto [iter, inserted] = m_context.receivers_properties.emplace(source_id, 
@@ -6,6 +6,7 @@
 #include "detail/common.hpp"
 #include "detail/message.hpp"
 #include "sender/detail/worker.hpp"
+#include "sender/detail/read_engine.hpp"
 
 namespace ya_uftp{
 	namespace sender{
@@ -81,6 +82,16 @@ namespace ya_uftp{
 				
 				api::optional<worker::send_args>	m_blocked_msg_args;
 				std::function<void()>				m_blocked_task;
+				
+				// shared by the file tasks of the session, which run one after another
+				std::unique_ptr<read_engine>		m_read_engine;
+				std::size_t							m_read_ahead_chunk_size;
+				std::size_t							m_read_ahead_window;
+				bool								m_zero_copy_send;
+				bool								m_repair_by_demand;
+				bool								m_repair_by_parity;
+				// 0 when the losses are asked about only at the end of the file
+				std::uint16_t						m_section_feedback_interval;
 			};
 		}
 	}
@@ -0,0 +1,50 @@
+#include "sender/detail/mapped_file.hpp"
+#include <limits>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+namespace ya_uftp{
+	namespace sender{
+		namespace detail{
+			mapped_file::mapped_file(const std::uint8_t* data, std::size_t size, private_ctor_tag tag) :
+				m_data(data), m_size(size){}
+			
+			mapped_file::~mapped_file(){
+#ifndef _WIN32
+				::munmap(const_cast<std::uint8_t*>(m_data), m_size);
+#endif
+			}
+			
+			std::shared_ptr<const mapped_file> mapped_file::map(const api::fs::path& path, std::uintmax_t size){
+#ifndef _WIN32
+				if (size == 0u or size > std::numeric_limits<std::size_t>::max())
+					return nullptr;
+				auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+				if (fd < 0)
+					return nullptr;
+				auto data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+				// the mapping holds its own reference to the file
+				::close(fd);
+				if (data == MAP_FAILED)
+					return nullptr;
+				::madvise(data, size, MADV_SEQUENTIAL);
+				return std::make_shared<const mapped_file>(static_cast<const std::uint8_t*>(data), size, private_ctor_tag{});
+#else
+				return nullptr;
+#endif
+			}
+			
+			const std::uint8_t* mapped_file::data() const{
+				return m_data;
+			}
+			
+			std::size_t mapped_file::size() const{
+				return m_size;
+			}
+		}
+	}
+}
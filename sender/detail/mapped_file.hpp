@@ -0,0 +1,33 @@
+#pragma once
+#ifndef YA_UFTP_SENDER_DETAIL_MAPPED_FILE_HPP_
+#define YA_UFTP_SENDER_DETAIL_MAPPED_FILE_HPP_
+
+#include "api_binder.hpp"
+#include <memory>
+#include <cstdint>
+
+namespace ya_uftp{
+	namespace sender{
+		namespace detail{
+			// a whole source file mapped read only, the packets sent from it share the ownership
+			// so the mapping outlives the kernel's use of the pages
+			class mapped_file{
+				struct private_ctor_tag{};
+				const std::uint8_t*	m_data = nullptr;
+				std::size_t			m_size = 0u;
+			public:
+				mapped_file(const std::uint8_t* data, std::size_t size, private_ctor_tag tag);
+				mapped_file(const mapped_file&) = delete;
+				mapped_file& operator=(const mapped_file&) = delete;
+				~mapped_file();
+				
+				// nullptr when the platform or the file does not allow it
+				static std::shared_ptr<const mapped_file> map(const api::fs::path& path, std::uintmax_t size);
+				const std::uint8_t* data() const;
+				std::size_t size() const;
+			};
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,253 @@
+#include "sender/detail/read_ahead.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+namespace ya_uftp{
+	namespace sender{
+		namespace detail{
+			namespace{
+				// keep the buffers friendly to O_DIRECT and the DMA
+				constexpr std::size_t buffer_alignment = 4096u;
+				
+				constexpr std::size_t round_to_alignment(std::size_t size){
+					return (size + buffer_alignment - 1) / buffer_alignment * buffer_alignment;
+				}
+			}
+			
+			read_ahead::read_ahead(read_engine& engine, int fd, std::uintmax_t file_size, std::size_t block_size, 
+				std::size_t chunk_size, std::size_t window, private_ctor_tag tag) :
+				m_engine(engine), m_fd(fd), m_file_size(file_size), m_block_size(block_size),
+				m_chunk_size(round_to_alignment(std::max(chunk_size, block_size))){
+				
+				window = std::max<std::size_t>(window, 2u);
+				const auto repair_size = round_to_alignment(block_size);
+				m_memory = static_cast<std::uint8_t*>(::operator new(window * m_chunk_size + max_repair_reads * repair_size, 
+					std::align_val_t{buffer_alignment}));
+				auto cursor = m_memory;
+				m_chunks.resize(window);
+				for (auto& s : m_chunks){
+					s.owner = this;
+					s.buffer = cursor;
+					cursor += m_chunk_size;
+				}
+				m_repairs.resize(max_repair_reads);
+				for (auto& s : m_repairs){
+					s.owner = this;
+					s.buffer = cursor;
+					cursor += repair_size;
+				}
+				m_batch.reserve(window + max_repair_reads);
+				m_completions.reserve(window + max_repair_reads);
+			}
+			
+			read_ahead::~read_ahead(){
+				{
+					// the buffers must not be freed under the reads still in flight
+					std::lock_guard engine_lock(m_engine.mutex());
+					while (m_in_flight > 0u)
+						reap(true);
+				}
+				::operator delete(m_memory, std::align_val_t{buffer_alignment});
+#ifndef _WIN32
+				::close(m_fd);
+#endif
+			}
+			
+			std::unique_ptr<read_ahead> read_ahead::open(read_engine& engine, const api::fs::path& path, 
+				std::uintmax_t file_size, std::size_t block_size, std::size_t chunk_size, std::size_t window){
+#ifndef _WIN32
+				auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+				if (fd < 0)
+					return nullptr;
+#ifdef POSIX_FADV_SEQUENTIAL
+				::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+				return std::make_unique<read_ahead>(engine, fd, file_size, block_size, chunk_size, window, private_ctor_tag{});
+#else
+				return nullptr;
+#endif
+			}
+			
+			read_ahead::slot* read_ahead::find_chunk(std::uint64_t chunk_offset){
+				for (auto& s : m_chunks){
+					if (s.state != slot_state::idle and s.offset == chunk_offset)
+						return &s;
+				}
+				return nullptr;
+			}
+			
+			read_ahead::slot* read_ahead::acquire_chunk_slot(std::uint64_t current_chunk, bool may_wait){
+				while (true){
+					auto victim = static_cast<slot*>(nullptr);
+					for (auto& s : m_chunks){
+						if (s.state == slot_state::idle)
+							return &s;
+						// behind the reading, or the farthest one when jumping backward
+						if (s.state == slot_state::ready and s.offset != current_chunk and
+							(s.offset < current_chunk or not victim or s.offset > victim->offset))
+							victim = &s;
+					}
+					if (victim and (victim->offset < current_chunk or may_wait)){
+						victim->state = slot_state::idle;
+						return victim;
+					}
+					if (not may_wait or m_in_flight == 0u)
+						return nullptr;
+					reap(true);
+				}
+			}
+			
+			void read_ahead::queue_read(slot& s, std::uint64_t offset, std::uint32_t length){
+				s.offset = offset;
+				s.length = length;
+				s.result = 0;
+				s.state = slot_state::in_flight;
+				m_batch.push_back(read_engine::request{m_fd, offset, s.buffer, length, &s});
+			}
+			
+			void read_ahead::submit_batch(){
+				auto submitted = std::size_t(0u);
+				while (submitted < m_batch.size()){
+					auto accepted = m_engine.submit(m_batch.data() + submitted, m_batch.size() - submitted);
+					m_in_flight += accepted;
+					submitted += accepted;
+					if (submitted < m_batch.size())
+						reap(true);
+				}
+				m_batch.clear();
+			}
+			
+			void read_ahead::fill_window(std::uint64_t current_chunk){
+				for (auto i = std::size_t(1u); i < m_chunks.size(); i++){
+					const auto chunk = current_chunk + i * m_chunk_size;
+					if (chunk >= m_file_size)
+						break;
+					if (find_chunk(chunk))
+						continue;
+					auto s = acquire_chunk_slot(current_chunk, false);
+					if (not s)
+						break;
+					queue_read(*s, chunk, static_cast<std::uint32_t>(std::min<std::uintmax_t>(m_chunk_size, m_file_size - chunk)));
+				}
+			}
+			
+			void read_ahead::reap(bool wait){
+				m_completions.clear();
+				m_engine.reap(m_completions, wait);
+				for (auto& c : m_completions){
+					// the engine may be shared, the completion belongs to whoever submitted it
+					auto s = static_cast<slot*>(c.user_data);
+					s->result = c.result;
+					s->state = slot_state::ready;
+					s->owner->m_in_flight--;
+				}
+			}
+			
+			void read_ahead::wait_for(slot& s){
+				if (not m_batch.empty())
+					submit_batch();
+				while (s.state == slot_state::in_flight)
+					reap(true);
+			}
+			
+			std::size_t read_ahead::copy_out(slot& s, std::uint64_t offset, api::blob_span dest){
+				if (s.result <= 0 or offset < s.offset or offset >= s.offset + s.result)
+					return 0u;
+				auto count = std::min<std::size_t>(dest.size(), s.offset + s.result - offset);
+				std::memcpy(dest.data(), s.buffer + (offset - s.offset), count);
+				return count;
+			}
+			
+			std::size_t read_ahead::read(std::uintmax_t offset, api::blob_span dest){
+				if (offset >= m_file_size)
+					return 0u;
+				const auto wanted = static_cast<std::size_t>(std::min<std::uintmax_t>(dest.size(), m_file_size - offset));
+				std::lock_guard engine_lock(m_engine.mutex());
+				
+				for (auto& s : m_repairs){
+					if (s.state != slot_state::idle and s.offset == offset and s.length >= wanted){
+						wait_for(s);
+						auto count = copy_out(s, offset, api::blob_span{dest.data(), static_cast<api::blob_span::size_type>(wanted)});
+						s.state = slot_state::idle;
+						if (count > 0u)
+							return count;
+						break;
+					}
+				}
+				
+				auto copied = std::size_t(0u);
+				while (copied < wanted){
+					const auto pos = offset + copied;
+					const auto chunk = pos / m_chunk_size * m_chunk_size;
+					auto s = find_chunk(chunk);
+					if (not s){
+						s = acquire_chunk_slot(chunk, true);
+						if (not s)
+							break;
+						queue_read(*s, chunk, static_cast<std::uint32_t>(std::min<std::uintmax_t>(m_chunk_size, m_file_size - chunk)));
+					}
+					fill_window(chunk);
+					wait_for(*s);
+					auto count = copy_out(*s, pos, api::blob_span{dest.data() + copied, 
+						static_cast<api::blob_span::size_type>(wanted - copied)});
+					if (count == 0u){
+						// let the next attempt read it again
+						if (s->result < 0)
+							s->state = slot_state::idle;
+						break;
+					}
+					copied += count;
+				}
+				return copied;
+			}
+			
+			std::size_t read_ahead::prefetch(const std::vector<std::uintmax_t>& offsets){
+				std::lock_guard engine_lock(m_engine.mutex());
+				auto count = std::size_t(0u);
+				auto free_slot = m_repairs.begin();
+				for (auto offset : offsets){
+					if (offset >= m_file_size)
+						continue;
+					auto present = std::any_of(m_repairs.begin(), m_repairs.end(), [offset](const slot& s){
+						return s.state != slot_state::idle and s.offset == offset;
+					});
+					if (not present){
+						free_slot = std::find_if(free_slot, m_repairs.end(), [](const slot& s){
+							return s.state == slot_state::idle;
+						});
+						if (free_slot == m_repairs.end())
+							break;
+						queue_read(*free_slot, offset, 
+							static_cast<std::uint32_t>(std::min<std::uintmax_t>(m_block_size, m_file_size - offset)));
+					}
+					count++;
+				}
+				if (not m_batch.empty())
+					submit_batch();
+				return count;
+			}
+			
+			std::size_t read_ahead::repair_slots_free() const{
+				return std::count_if(m_repairs.begin(), m_repairs.end(), [](const slot& s){
+					return s.state == slot_state::idle;
+				});
+			}
+			
+			void read_ahead::release_repairs(){
+				std::lock_guard engine_lock(m_engine.mutex());
+				for (auto& s : m_repairs){
+					// the disk may still be writing into the buffer
+					if (s.state == slot_state::in_flight)
+						wait_for(s);
+					s.state = slot_state::idle;
+				}
+			}
+		}
+	}
+}
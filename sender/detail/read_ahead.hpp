@@ -0,0 +1,81 @@
+#pragma once
+#ifndef YA_UFTP_SENDER_DETAIL_READ_AHEAD_HPP_
+#define YA_UFTP_SENDER_DETAIL_READ_AHEAD_HPP_
+
+#include "sender/detail/read_engine.hpp"
+#include "api_binder.hpp"
+#include <vector>
+
+namespace ya_uftp{
+	namespace sender{
+		namespace detail{
+			// keeps a window of large reads ahead of the sequential sending, and small batched reads 
+			// for the blocks to be repaired. the blocks are then copied out of the ready buffers.
+			class read_ahead{
+				struct private_ctor_tag{};
+				enum class slot_state : std::uint8_t{
+					idle,
+					in_flight,
+					ready
+				};
+				struct slot{
+					read_ahead*		owner;
+					std::uint8_t*	buffer;
+					std::uint64_t	offset = 0u;
+					std::uint32_t	length = 0u;
+					// bytes read or -errno
+					std::int64_t	result = 0;
+					slot_state		state = slot_state::idle;
+				};
+				
+				read_engine&			m_engine;
+				int						m_fd = -1;
+				std::uintmax_t			m_file_size;
+				std::size_t				m_block_size;
+				std::size_t				m_chunk_size;
+				std::uint8_t*			m_memory = nullptr;
+				std::vector<slot>		m_chunks;
+				std::vector<slot>		m_repairs;
+				std::size_t				m_in_flight = 0u;
+				std::vector<read_engine::request>		m_batch;
+				std::vector<read_engine::completion>	m_completions;
+				
+				slot* find_chunk(std::uint64_t chunk_offset);
+				// a slot not needed any more by the sequential reading at current_chunk
+				slot* acquire_chunk_slot(std::uint64_t current_chunk, bool may_wait);
+				void queue_read(slot& s, std::uint64_t offset, std::uint32_t length);
+				void submit_batch();
+				void fill_window(std::uint64_t current_chunk);
+				void wait_for(slot& s);
+				void reap(bool wait);
+				std::size_t copy_out(slot& s, std::uint64_t offset, api::blob_span dest);
+			public:
+				// the most of repair reads in flight
+				static constexpr std::size_t	max_repair_reads = 64u;
+				
+				read_ahead(read_engine& engine, int fd, std::uintmax_t file_size, std::size_t block_size, 
+					std::size_t chunk_size, std::size_t window, private_ctor_tag tag);
+				read_ahead(const read_ahead&) = delete;
+				read_ahead& operator=(const read_ahead&) = delete;
+				~read_ahead();
+				
+				// nullptr if the file can not be opened
+				static std::unique_ptr<read_ahead> open(read_engine& engine, const api::fs::path& path, 
+					std::uintmax_t file_size, std::size_t block_size, std::size_t chunk_size, std::size_t window);
+				
+				// copy the file content at offset, waiting for the disk if it is not there yet.
+				// return the bytes copied, less than the dest size at the end of file or on error
+				std::size_t read(std::uintmax_t offset, api::blob_span dest);
+				// issue the reads of these blocks(offsets) in one batch, they are going to be read soon and randomly.
+				// return how many of them are in flight or ready
+				std::size_t prefetch(const std::vector<std::uintmax_t>& offsets);
+				// how many more repair reads can be prefetched now
+				std::size_t repair_slots_free() const;
+				// give back the repair slots whose blocks are not going to be read, waiting for those in flight
+				void release_repairs();
+			};
+		}
+	}
+}
+
+#endif
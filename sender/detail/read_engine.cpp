@@ -0,0 +1,194 @@
+#include "sender/detail/read_engine.hpp"
+#include "detail/io_ring.hpp"
+#include "detail/ring_queue.hpp"
+
+#include <thread>
+#include <condition_variable>
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#endif
+
+namespace ya_uftp{
+	namespace sender{
+		namespace detail{
+			read_engine::~read_engine() = default;
+			
+			std::mutex& read_engine::mutex(){
+				return m_users_mutex;
+			}
+			
+			namespace{
+#ifdef YA_UFTP_HAS_IO_URING
+				class io_uring_read_engine : public read_engine{
+					std::unique_ptr<ya_uftp::detail::io_ring>	m_ring;
+					std::size_t		m_in_flight = 0u;
+				public:
+					explicit io_uring_read_engine(std::unique_ptr<ya_uftp::detail::io_ring> ring) : m_ring(std::move(ring)){}
+					
+					std::size_t submit(const request* requests, std::size_t count) override{
+						auto accepted = std::size_t(0u);
+						for (; accepted < count and m_in_flight < capacity(); accepted++, m_in_flight++){
+							auto sqe = m_ring->get_sqe();
+							if (not sqe)
+								break;
+							auto& req = requests[accepted];
+							sqe->opcode = IORING_OP_READ;
+							sqe->fd = req.fd;
+							sqe->off = req.offset;
+							sqe->addr = reinterpret_cast<std::uint64_t>(req.buffer);
+							sqe->len = req.length;
+							sqe->user_data = reinterpret_cast<std::uint64_t>(req.user_data);
+						}
+						// what a failed enter leaves in the ring is submitted again by the next submit or reap
+						if (accepted > 0u)
+							m_ring->submit();
+						return accepted;
+					}
+					
+					void reap(std::vector<completion>& out, bool wait) override{
+						if (not wait and m_ring->unsubmitted() > 0u)
+							m_ring->submit();
+						auto reaped = m_ring->consume_completions([&out](const ::io_uring_cqe& cqe){
+							out.push_back(completion{reinterpret_cast<void*>(cqe.user_data), cqe.res});
+						});
+						while (reaped == 0u and wait and m_in_flight > 0u){
+							if (auto result = m_ring->submit(1u); result < 0 and result != -EAGAIN and result != -EBUSY)
+								break;
+							reaped = m_ring->consume_completions([&out](const ::io_uring_cqe& cqe){
+								out.push_back(completion{reinterpret_cast<void*>(cqe.user_data), cqe.res});
+							});
+						}
+						m_in_flight -= reaped;
+					}
+					
+					std::size_t capacity() const override{
+						return m_ring->entries();
+					}
+					
+					task::read_backend backend() const override{
+						return task::read_backend::io_uring;
+					}
+				};
+				
+				// io_uring_setup may succeed while the reads are still refused(old kernels, seccomp), try one for real
+				bool can_read_through(ya_uftp::detail::io_ring& ring){
+					auto fd = ::open("/dev/zero", O_RDONLY | O_CLOEXEC);
+					if (fd < 0)
+						return false;
+					auto byte = std::uint8_t{0xffu};
+					auto sqe = ring.get_sqe();
+					sqe->opcode = IORING_OP_READ;
+					sqe->fd = fd;
+					sqe->addr = reinterpret_cast<std::uint64_t>(&byte);
+					sqe->len = 1u;
+					auto result = -1;
+					if (ring.submit(1u) >= 0)
+						ring.consume_completions([&result](const ::io_uring_cqe& cqe){ result = cqe.res; });
+					::close(fd);
+					return result == 1 and byte == 0u;
+				}
+#endif
+
+#ifndef _WIN32
+				class thread_pool_read_engine : public read_engine{
+					std::mutex							m_mutex;
+					std::condition_variable				m_work_cv;
+					std::condition_variable				m_done_cv;
+					ya_uftp::detail::ring_queue<request>	m_pending;
+					std::vector<completion>				m_completed;
+					std::size_t							m_in_flight = 0u;
+					const std::size_t					m_capacity;
+					bool								m_stopping = false;
+					std::vector<std::thread>			m_threads;
+					
+					void run(){
+						std::unique_lock lock(m_mutex);
+						while (true){
+							m_work_cv.wait(lock, [this](){ return m_stopping or not m_pending.empty(); });
+							if (m_stopping)
+								return;
+							auto req = m_pending.front();
+							m_pending.pop();
+							lock.unlock();
+							auto result = ::ssize_t(0);
+							do {
+								result = ::pread(req.fd, req.buffer, req.length, static_cast<::off_t>(req.offset));
+							} while (result < 0 and errno == EINTR);
+							auto done = completion{req.user_data, result < 0 ? -errno : result};
+							lock.lock();
+							m_completed.push_back(done);
+							m_done_cv.notify_one();
+						}
+					}
+				public:
+					thread_pool_read_engine(std::size_t threads_count, std::size_t capacity) : m_capacity(capacity){
+						m_completed.reserve(capacity);
+						for (auto i = std::size_t(0u); i < threads_count; i++)
+							m_threads.emplace_back([this](){ run(); });
+					}
+					
+					~thread_pool_read_engine(){
+						{
+							std::lock_guard lock(m_mutex);
+							m_stopping = true;
+						}
+						m_work_cv.notify_all();
+						for (auto& t : m_threads)
+							t.join();
+					}
+					
+					std::size_t submit(const request* requests, std::size_t count) override{
+						auto accepted = std::size_t(0u);
+						{
+							std::lock_guard lock(m_mutex);
+							for (; accepted < count and m_in_flight < m_capacity; accepted++, m_in_flight++)
+								m_pending.emplace(requests[accepted]);
+						}
+						if (accepted > 1u)
+							m_work_cv.notify_all();
+						else if (accepted == 1u)
+							m_work_cv.notify_one();
+						return accepted;
+					}
+					
+					void reap(std::vector<completion>& out, bool wait) override{
+						std::unique_lock lock(m_mutex);
+						if (wait)
+							m_done_cv.wait(lock, [this](){ return not m_completed.empty() or m_in_flight == 0u; });
+						m_in_flight -= m_completed.size();
+						out.insert(out.end(), m_completed.begin(), m_completed.end());
+						m_completed.clear();
+					}
+					
+					std::size_t capacity() const override{
+						return m_capacity;
+					}
+					
+					task::read_backend backend() const override{
+						return task::read_backend::thread_pool;
+					}
+				};
+#endif
+			}
+			
+			std::unique_ptr<read_engine> read_engine::create(task::read_backend backend, std::size_t queue_depth){
+#ifdef YA_UFTP_HAS_IO_URING
+				if (backend == task::read_backend::automatic or backend == task::read_backend::io_uring){
+					if (auto ring = ya_uftp::detail::io_ring::create(static_cast<unsigned>(queue_depth)); 
+						ring and can_read_through(*ring))
+						return std::make_unique<io_uring_read_engine>(std::move(ring));
+				}
+#endif
+#ifndef _WIN32
+				// the NVMe drives serve several reads in parallel, a few threads are enough to keep them busy
+				constexpr auto read_threads_count = 4u;
+				if (backend != task::read_backend::stream)
+					return std::make_unique<thread_pool_read_engine>(read_threads_count, queue_depth);
+#endif
+				return nullptr;
+			}
+		}
+	}
+}
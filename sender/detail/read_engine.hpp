@@ -0,0 +1,49 @@
+#pragma once
+#ifndef YA_UFTP_SENDER_DETAIL_READ_ENGINE_HPP_
+#define YA_UFTP_SENDER_DETAIL_READ_ENGINE_HPP_
+
+#include "sender/adi.hpp"
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+namespace ya_uftp{
+	namespace sender{
+		namespace detail{
+			// positional reads submitted in batches, the completions are reaped by the submitter.
+			// the users of one engine serialize on mutex() since whoever reaps may reap the completions of others
+			class read_engine{
+				std::mutex	m_users_mutex;
+			public:
+				struct request{
+					int				fd;
+					std::uint64_t	offset;
+					std::uint8_t*	buffer;
+					std::uint32_t	length;
+					void*			user_data;
+				};
+				struct completion{
+					void*			user_data;
+					// bytes read or -errno
+					std::int64_t	result;
+				};
+				
+				virtual ~read_engine();
+				// return the count accepted, the rest should be submitted again after reaping some
+				virtual std::size_t submit(const request* requests, std::size_t count) = 0;
+				// append the completions available to out, wait for at least one if asked to
+				virtual void reap(std::vector<completion>& out, bool wait) = 0;
+				// max reads in flight
+				virtual std::size_t capacity() const = 0;
+				virtual task::read_backend backend() const = 0;
+				std::mutex& mutex();
+				
+				// nullptr when no backend asked for is available on the platform(the caller falls back to the streams)
+				static std::unique_ptr<read_engine> create(task::read_backend backend, std::size_t queue_depth);
+			};
+		}
+	}
+}
+
+#endif
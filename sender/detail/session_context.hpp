@@ -4,6 +4,7 @@
 
 #include "sender/adi.hpp"
 #include "detail/message.hpp"
+#include "detail/packet_pool.hpp"
 
 namespace ya_uftp{
 	namespace sender{
@@ -17,7 +18,6 @@ namespace ya_uftp{
 				std::uint32_t					session_id;
 				std::uint8_t					task_instance;
 				std::chrono::microseconds		grtt;
-				std::uint16_t					msg_seq_num = 0u;
 				const std::uint16_t				block_size;
 				std::uint8_t					robust_factor;
 				bool							follow_symbolic_link;
@@ -25,6 +25,8 @@ namespace ya_uftp{
 				bool							quit_on_error;
 				
 				api::optional<std::uint64_t>	transfer_speed;
+				// the fec offered in ANNOUNCE, if any
+				api::optional<task::parameters::fec_ratio>	fec;
 				
 				struct receiver_properties{
 					enum class status : std::uint8_t{
@@ -46,10 +48,14 @@ namespace ya_uftp{
 					status		current_status;
 					bool		confirm_sent = false;
 					bool		is_proxy = false;
+					// took the fec offered in its REGISTER
+					bool		fec = false;
 					api::optional<std::chrono::microseconds> rtt;
 				};
 				
 				std::map<message::member_id, receiver_properties>	receivers_properties;
+				// bumped by every message sent, only in the net thread, away from what the file thread reads
+				alignas(ya_uftp::detail::cache_line_size) std::uint16_t	msg_seq_num = 0u;
 				
 				session_context(bool open_group, std::uint16_t blk_size);
 				session_context(const session_context&) = delete;
@@ -1,9 +1,23 @@
 #include "sender/detail/worker.hpp"
 
+#include "detail/fec.hpp"
 #include "boost/endian/conversion.hpp"
 
+#include <algorithm>
 #include <iostream>
 
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <linux/errqueue.h>
+#include <errno.h>
+#include <cstring>
+#if defined(SO_ZEROCOPY) and defined(MSG_ZEROCOPY) and defined(SO_EE_ORIGIN_ZEROCOPY)
+#define YA_UFTP_HAS_MSG_ZEROCOPY 1
+#endif
+#endif
+
 namespace ya_uftp{
 	namespace sender{
 		namespace detail{
@@ -13,6 +27,30 @@ namespace ya_uftp{
 			
 			worker::employer::~employer() = default;
 			
+			worker::send_completion::~send_completion() = default;
+			
+			void worker::lane_counters::on_dequeued(std::chrono::steady_clock::time_point queued_at, 
+				std::chrono::steady_clock::time_point now){
+				const auto waited = static_cast<std::uint64_t>(
+					std::chrono::duration_cast<std::chrono::microseconds>(now - queued_at).count());
+				depth.fetch_sub(1u, std::memory_order_relaxed);
+				datagrams.fetch_add(1u, std::memory_order_relaxed);
+				total_wait_us.fetch_add(waited, std::memory_order_relaxed);
+				// only the net thread dequeues
+				if (waited > max_wait_us.load(std::memory_order_relaxed))
+					max_wait_us.store(waited, std::memory_order_relaxed);
+			}
+			
+			task::queue_statistics worker::lane_counters::snapshot() const{
+				auto stats = task::queue_statistics{};
+				stats.depth = depth.load(std::memory_order_relaxed);
+				stats.datagrams = datagrams.load(std::memory_order_relaxed);
+				stats.max_wait = std::chrono::microseconds(max_wait_us.load(std::memory_order_relaxed));
+				if (stats.datagrams > 0u)
+					stats.average_wait = std::chrono::microseconds(total_wait_us.load(std::memory_order_relaxed) / stats.datagrams);
+				return stats;
+			}
+			
 			worker::worker(boost::asio::io_context& net_io_ctx, 
 						boost::asio::io_context& file_io_ctx,
 					const task::parameters& params)
@@ -21,15 +59,25 @@ namespace ya_uftp{
 				m_rc_timer(m_net_io_ctx),
 				m_session_context((params.allowed_clients and not params.allowed_clients->empty()) ? false : true, 
 					params.block_size),
-				// set the bucket size to 1.25 times everycycle consumed to avoid drain
-				m_bucket_full_size(params.max_speed ? (params.max_speed.value() / m_rc_send_per_second / 4 * 5) : 0){
+				// FILE_SEG is the largest packet sent, the feedback read is at most 1500 bytes
+				m_packet_pool(std::max<std::size_t>(params.block_size + 200u, 1500u), params.packet_pool_size, 
+					params.packet_pool_hugepages),
+				// keep about 60ms worth of datagrams queued for the pacer, and at least a few bursts.
+				// without rate control the queue is only bounded to leave half of the pool to the producer
+				m_bucket_full_size(params.max_speed ? 
+					static_cast<std::uint32_t>(std::max<std::uint64_t>(params.max_speed.value() / 16, params.pacing_burst_size * 4)) : 
+					static_cast<std::uint32_t>(std::max<std::size_t>(params.packet_pool_size / 2, 64u) * params.block_size)),
+				m_pacing_burst_size(static_cast<std::int64_t>(std::max<std::uint64_t>({ params.pacing_burst_size, params.block_size + 200u, 
+					params.max_speed.value_or(0u) / static_cast<std::uint64_t>(std::chrono::seconds(1) / m_pacing_burst_time) }))),
+				m_alive_token(std::make_shared<worker*>(this)),
+				m_flush_handler_memory(std::make_shared<ya_uftp::detail::handler_memory>()){
 					m_session_context.quit_on_error = params.quit_on_error;
 					m_session_context.public_mcast_dest = boost::asio::ip::udp::endpoint{params.public_multicast_addr, params.destination_port};
 					m_session_context.private_mcast_dest = boost::asio::ip::udp::endpoint{params.private_multicast_addr, params.destination_port};
 					m_session_context.grtt = params.grtt; 
 					m_session_context.transfer_speed = params.max_speed;
-					if (m_session_context.transfer_speed)
-						m_rc_per_round_bytes_count = m_session_context.transfer_speed.value() / 20;
+					if (params.fec and ya_uftp::detail::fec_codec::valid(params.fec->data_blocks, params.fec->parity_blocks))
+						m_session_context.fec = params.fec;
 					
 					if (params.public_multicast_addr.is_v4()){
 						auto ec = boost::system::error_code{};
@@ -52,6 +100,36 @@ namespace ya_uftp{
 						}
 					}
 					
+					// datagrams are flushed synchronously from the net thread, 
+					// a full socket buffer must not block it
+					{
+						auto ec = boost::system::error_code{};
+						m_socket.non_blocking(true, ec);
+					}
+					m_flushing.reserve(m_max_datagrams_per_syscall);
+#ifdef __linux__
+					// probe for the segmentation offload support, the route may still refuse it later
+					if (params.enable_udp_gso){
+						auto segment_size = 0;
+						auto opt_len = static_cast<::socklen_t>(sizeof(segment_size));
+						m_gso_enabled = ::getsockopt(m_socket.native_handle(), SOL_UDP, UDP_SEGMENT, &segment_size, &opt_len) == 0;
+					}
+#endif
+#if defined(__linux__) and defined(SO_MAX_PACING_RATE)
+					// the fq qdisc spaces the datagrams of a burst on the wire as well, other qdiscs ignore it
+					if (params.max_speed and params.kernel_pacing){
+						auto pacing_rate = static_cast<std::uint64_t>(params.max_speed.value());
+						::setsockopt(m_socket.native_handle(), SOL_SOCKET, SO_MAX_PACING_RATE, &pacing_rate, sizeof(pacing_rate));
+					}
+#endif
+#ifdef YA_UFTP_HAS_MSG_ZEROCOPY
+					// without it the attachments are still gathered in place, the kernel just copies them
+					if (params.zero_copy_send){
+						auto enable = 1;
+						m_zerocopy_enabled = ::setsockopt(m_socket.native_handle(), SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) == 0;
+					}
+#endif
+					
 					// fixup unspecified parameters
 					if (not params.server_id){
 						auto server_id_set = false;
@@ -135,7 +213,7 @@ namespace ya_uftp{
 				worker::write_receivers_id(api::blob_span buffer,
 					std::map<std::uint32_t, session_context::receiver_properties>& receivers_states,
 					std::map<std::uint32_t, session_context::receiver_properties>::iterator start,
-					std::function<bool (session_context::receiver_properties&)> filter){
+					function_ref<bool (session_context::receiver_properties&)> filter){
 				auto ids_buf = api::span<std::uint32_t>{reinterpret_cast<std::uint32_t *>(buffer.data()), 
 					static_cast<api::span<std::uint32_t>::size_type>(buffer.size() / sizeof(std::uint32_t))}; 
 				auto i = 0u;
@@ -151,51 +229,85 @@ namespace ya_uftp{
 			
 			void worker::
 				loop_do_rc_send(){
-				auto bytes_sent = 0u;
-				m_rc_timer.expires_after(std::chrono::milliseconds(50));
-				m_rc_timer.async_wait([this](const boost::system::error_code ec){
-					if (not ec)
-						loop_do_rc_send();
+				const auto now = std::chrono::steady_clock::now();
+				const auto rate = m_session_context.transfer_speed.value();
+				
+				auto need_flush = false;
+				auto queue_drained = false;
+				auto queued_length = 0u;
+				auto credit = std::int64_t(0);
+				{
+					std::lock_guard queue_lock(m_queue_mutex);
+					// the credit refills continuously, but never beyond one burst
+					const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_pacing_last_refill);
+					m_pacing_last_refill = now;
+					m_pacing_credit = std::min<std::int64_t>(m_pacing_burst_size, 
+						m_pacing_credit + static_cast<std::int64_t>(elapsed.count() * static_cast<double>(rate) / 1e9));
+					// the last datagram may overdraw the credit, the debt is paid before the next release
+					auto bytes_released = 0u;
+					while (not m_sendout_queue.empty() and m_pacing_credit > 0){
+						auto length = std::get<1>(m_sendout_queue.front().first);
+						m_flush_queue.emplace(std::move(m_sendout_queue.front()));
+						m_pacing_credit -= length;
+						bytes_released += length;
+						m_queued_packets_total_length -= length;
+						m_sendout_queue.pop();
+					}
+					if (bytes_released > 0)
+						need_flush = schedule_flush(true);
+					queued_length = m_queued_packets_total_length;
+					queue_drained = m_sendout_queue.empty();
+					credit = m_pacing_credit;
+				}
+				
+				// wake up when half a burst is earned, so a timer firing late by up to 
+				// half a burst time still does not waste any credit
+				auto wait = std::chrono::nanoseconds(static_cast<std::int64_t>(
+					(m_pacing_burst_size / 2 - credit) * 1e9 / static_cast<double>(rate)));
+				// nothing left to release, sleep until the credit is full, none is lost before. once full,
+				// the idle pacer still only wakes once per burst time
+				if (queue_drained)
+					wait = std::max<std::chrono::nanoseconds>(m_pacing_burst_time, std::chrono::nanoseconds(static_cast<std::int64_t>(
+						(m_pacing_burst_size - credit) * 1e9 / static_cast<double>(rate))));
+				m_rc_timer.expires_at(now + wait);
+				// a wakeup already due is not cancelled with the worker, it must not reach the worker gone
+				m_rc_timer.async_wait([alive = std::weak_ptr<worker*>{m_alive_token}](const boost::system::error_code ec){
+					if (auto self = alive.lock(); self and not ec)
+						(*self)->loop_do_rc_send();
 				});
 				
-				while (not m_sendout_queue.empty() and
-						bytes_sent < m_rc_per_round_bytes_count){
-					auto [msg, length, dest, handler] = m_sendout_queue.front();
-					m_socket.async_send_to(boost::asio::buffer(msg->data(), length),
-						dest, [this, handler = std::move(handler), msg = msg](const boost::system::error_code ec, std::size_t bytes_sent){
-							if (handler)
-								handler(ec, bytes_sent);
-						});
-					bytes_sent += length;
-					m_queued_packets_total_length -= length;
-					m_sendout_queue.pop();
+				if (need_flush)
+					do_flush_datagrams();
+				
+				if (queued_length < m_bucket_full_size)
+					notify_bucket_freed();
+			}
+			
+			void worker::notify_bucket_freed(){
+				/*
+				for (auto employer_weak : m_employers){
+					auto boss = employer_weak.lock();
+					if (boss)
+						boss->on_worker_bucket_freed();
+					
 				}
-				if (m_queued_packets_total_length < m_bucket_full_size){
-					/*
-					for (auto employer_weak : m_employers){
-						auto boss = employer_weak.lock();
-						if (boss)
-							boss->on_worker_bucket_freed();
-						
-					}
-					*/
-					auto can_tell_boss = true;
-					if (m_blocked_packets_params){
-						auto [pkts, idx, total_sent_size, handler] = m_blocked_packets_params.value();
-						auto [all_sent, bytes_sent] = send_multiple_packets(pkts, handler, idx);
-						
-						can_tell_boss = all_sent;
-					}
-					if (can_tell_boss){
-						auto boss = m_employer.lock();
-						if (boss)
-							boss->on_worker_bucket_freed();
-					}
+				*/
+				auto can_tell_boss = true;
+				if (m_blocked_packets_params){
+					auto [pkts, idx, total_sent_size, handler] = m_blocked_packets_params.value();
+					auto [all_sent, bytes_sent] = send_multiple_packets(pkts, handler, idx);
+					
+					can_tell_boss = all_sent;
+				}
+				if (can_tell_boss){
+					auto boss = m_employer.lock();
+					if (boss)
+						boss->on_worker_bucket_freed();
 				}
 			}
 			
 			std::size_t worker::
-				do_complete_message(message_blob msg, std::function<std::size_t (api::blob_span)> write_body){
+				do_complete_message(const message_blob& msg, body_writer write_body){
 				
 				auto msg_length = *(msg->data() + sizeof(message::protocol_header) + 1) * message::header_length_unit + sizeof(message::protocol_header);
 				if (write_body)
@@ -252,21 +364,36 @@ namespace ya_uftp{
 			}
 			
 			void worker::setup_header(message::protocol_header& uftp_hdr, message::role r){
-				uftp_hdr.message_role = r;
+				setup_header_template(uftp_hdr, r);
 				uftp_hdr.sequence_number = boost::endian::native_to_big(m_session_context.msg_seq_num++);
+			}
+			
+			void worker::setup_header_template(message::protocol_header& uftp_hdr, message::role r){
+				uftp_hdr.message_role = r;
+				uftp_hdr.sequence_number = 0u;
 				uftp_hdr.source_id = m_session_context.in_group_id;
 				uftp_hdr.session_id = m_session_context.session_id;
 				uftp_hdr.group_instance = m_session_context.task_instance;
-				uftp_hdr.grtt = message::quantize_grtt(static_cast<double>(m_session_context.grtt.count()) / 1000000);
+				uftp_hdr.grtt = quantized_grtt();
 				// ToDo: support group size
 				uftp_hdr.group_size = 0u;
 			}
 			
+			std::uint8_t worker::quantized_grtt(){
+				const auto grtt = static_cast<std::uint64_t>(m_session_context.grtt.count());
+				const auto cached = m_quantized_grtt_cache.load(std::memory_order_relaxed);
+				if ((cached >> 8) == grtt)
+					return static_cast<std::uint8_t>(cached);
+				const auto quantized = message::quantize_grtt(static_cast<double>(grtt) / 1000000);
+				m_quantized_grtt_cache.store((grtt << 8) | quantized, std::memory_order_relaxed);
+				return quantized;
+			}
+			
 			// ToDo: support rate control
 			[[nodiscard]]
 			std::pair<bool, std::size_t> worker::send_packet(message_blob packet, 
 				const boost::asio::ip::udp::endpoint& dest,
-				std::function<std::size_t (api::blob_span)> write_body, 
+				body_writer write_body, 
 				api::optional<std::size_t> known_length,
 				//std::function<void(const boost::system::error_code, std::size_t)> result_handler){
 				rw_handler result_handler){
@@ -280,26 +407,38 @@ namespace ya_uftp{
 					msg_length = known_length.value();
 				else
 					msg_length = do_complete_message(packet, write_body);
-				if (m_session_context.transfer_speed){
+				// the parity follows the blocks of its group and is paced like them
+				const auto role = reinterpret_cast<const message::protocol_header*>(packet->data())->message_role;
+				const auto is_control = role != message::role::file_seg and role != message::role::file_parity;
+				const auto now = std::chrono::steady_clock::now();
+				std::lock_guard queue_lock(m_queue_mutex);
+				if (is_control){
+					// go out with the next flush, yet the pacer makes the data pay for the bandwidth taken
+					if (m_session_context.transfer_speed)
+						m_pacing_credit -= msg_length;
+					m_control_queue.emplace(send_args{std::move(packet), msg_length, dest, std::move(result_handler)}, now);
+					m_control_lane.depth.fetch_add(1u, std::memory_order_relaxed);
+					schedule_flush(false);
+					successful = true;
+				}
+				else if (m_session_context.transfer_speed){
 					if (m_queued_packets_total_length < m_bucket_full_size){
 						m_queued_packets_total_length += msg_length;
-						m_sendout_queue.emplace(std::move(packet), msg_length, dest, std::move(result_handler));
-						
+						m_sendout_queue.emplace(send_args{std::move(packet), msg_length, dest, std::move(result_handler)}, now);
+						m_data_lane.depth.fetch_add(1u, std::memory_order_relaxed);
 						successful = true;
 					}
 				}
-				// send directly when no transfer speed specified(i.e. no rate control)
-				else{
-					m_socket.async_send_to(boost::asio::buffer(packet->data(), msg_length),
-						dest,
-						[packet, handler = std::move(result_handler), this]
-						(const boost::system::error_code ec, std::size_t bytes_sent){
-							//m_last_send_done = true;
-							if (handler)
-								handler(ec, bytes_sent);
-						});
+				// queue for the next flush directly when no transfer speed specified(i.e. no rate control)
+				else if (m_queued_packets_total_length < m_bucket_full_size){
+					m_queued_packets_total_length += msg_length;
+					m_flush_queue.emplace(send_args{std::move(packet), msg_length, dest, std::move(result_handler)}, now);
+					m_data_lane.depth.fetch_add(1u, std::memory_order_relaxed);
+					schedule_flush(false);
 					successful = true;
 				}
+				else
+					m_data_refused = true;
 				return std::pair(successful, msg_length);
 			}
 			
@@ -318,13 +457,13 @@ namespace ya_uftp{
 					};
 				
 				auto packets_buffer = std::make_shared<std::vector<send_args>>();
-				auto msg_copy = make_message_blob(*packet);
+				auto msg_copy = m_packet_pool.make(*packet);
 				while (recv_iter != m_session_context.receivers_properties.end()){
 					auto msg_len = do_complete_message(msg_copy, write_body);
 					packets_buffer->emplace_back(msg_copy, msg_len, std::ref(dest), nullptr);
 					// only when need to send next we should increment the sequence_number
 					if (recv_iter != m_session_context.receivers_properties.end()){
-						msg_copy = make_message_blob(*msg_copy);
+						msg_copy = m_packet_pool.make(*msg_copy);
 						auto uftp_hdr = reinterpret_cast<message::protocol_header *>(msg_copy->data());
 						uftp_hdr->sequence_number = boost::endian::native_to_big(m_session_context.msg_seq_num++);
 					}
@@ -345,8 +484,8 @@ namespace ya_uftp{
 			}
 			
 			void worker::loop_read_packet(){
-				auto buf = make_message_blob(1500);
-				m_socket.async_receive_from(boost::asio::buffer(*buf),
+				auto buf = m_packet_pool.make(1500);
+				m_socket.async_receive_from(boost::asio::buffer(buf->data(), buf->size()),
 					m_sender_endpoint,
 					[this, buf](const boost::system::error_code ec, 
 						std::size_t bytes_read){
@@ -439,6 +578,365 @@ namespace ya_uftp{
 				worker::get_context() {
 				return m_session_context;
 			}
+			
+			ya_uftp::detail::packet_pool& worker::packet_pool(){
+				return m_packet_pool;
+			}
+			
+			task::statistics worker::statistics() const{
+				auto stats = task::statistics{};
+				stats.datagrams_sent = m_datagrams_sent.load(std::memory_order_relaxed);
+				stats.send_syscalls = m_send_syscalls.load(std::memory_order_relaxed);
+				stats.packet_pool_misses = m_packet_pool.misses();
+				stats.zero_copy_sends = m_zerocopy_sends.load(std::memory_order_relaxed);
+				stats.zero_copy_copied = m_zerocopy_copied.load(std::memory_order_relaxed);
+				stats.control_queue = m_control_lane.snapshot();
+				stats.data_queue = m_data_lane.snapshot();
+				return stats;
+			}
+			
+			bool worker::schedule_flush(bool in_net_thread){
+				if (m_flush_scheduled)
+					return false;
+				m_flush_scheduled = true;
+				if (in_net_thread)
+					return true;
+				boost::asio::post(m_net_io_ctx, ya_uftp::detail::make_handler_with_memory(m_flush_handler_memory, 
+					[alive = std::weak_ptr<worker*>{m_alive_token}](){
+						if (auto self = alive.lock())
+							(*self)->do_flush_datagrams();
+					}));
+				return false;
+			}
+			
+			void worker::do_flush_datagrams(){
+				if (not m_zerocopy_pending.empty())
+					reap_zerocopy_completions();
+				for (auto syscalls = 0u; syscalls < m_max_syscalls_per_flush; syscalls++){
+					if (m_flushing_done == m_flushing.size()){
+						m_flushing.clear();
+						m_flushing_done = 0u;
+						const auto now = std::chrono::steady_clock::now();
+						std::lock_guard queue_lock(m_queue_mutex);
+						// the control messages jump ahead of the data released so far
+						while (not m_control_queue.empty() and 
+							m_flushing.size() < m_max_datagrams_per_syscall){
+							auto& [args, queued_at] = m_control_queue.front();
+							m_control_lane.on_dequeued(queued_at, now);
+							m_flushing.emplace_back(std::move(args));
+							m_control_queue.pop();
+						}
+						const auto rate_controlled = m_session_context.transfer_speed.has_value();
+						while (not m_flush_queue.empty() and 
+							m_flushing.size() < m_max_datagrams_per_syscall){
+							auto& [args, queued_at] = m_flush_queue.front();
+							m_data_lane.on_dequeued(queued_at, now);
+							// the pacer accounts the rate controlled datagrams when it releases them
+							if (not rate_controlled)
+								m_queued_packets_total_length -= std::get<1>(args);
+							m_flushing.emplace_back(std::move(args));
+							m_flush_queue.pop();
+						}
+						if (m_data_refused and m_queued_packets_total_length < m_bucket_full_size){
+							m_data_refused = false;
+							// the employer sends right from the notification, so let it run out of the flush
+							boost::asio::post(m_net_io_ctx, [alive = std::weak_ptr<worker*>{m_alive_token}](){
+								if (auto self = alive.lock())
+									(*self)->notify_bucket_freed();
+							});
+						}
+						if (m_flushing.empty()){
+							m_flush_scheduled = false;
+							return;
+						}
+					}
+					
+					auto [sent_count, ec] = send_datagrams();
+					auto first_unsent = m_flushing_done + sent_count;
+					for (; m_flushing_done < first_unsent; m_flushing_done++){
+						auto& [msg, length, dest, handler] = m_flushing[m_flushing_done];
+						if (handler)
+							handler(boost::system::error_code{}, length);
+					}
+					if (ec == boost::asio::error::would_block or 
+						ec == boost::asio::error::try_again){
+						m_socket.async_wait(boost::asio::ip::udp::socket::wait_write, ya_uftp::detail::make_handler_with_memory(m_flush_handler_memory, 
+							[alive = std::weak_ptr<worker*>{m_alive_token}](const boost::system::error_code ec){
+								auto self = alive.lock();
+								if (not self)
+									return;
+								if (not ec)
+									(*self)->do_flush_datagrams();
+								else{
+									// the unsent datagrams stay queued, the next send will reschedule the flush
+									std::lock_guard queue_lock((*self)->m_queue_mutex);
+									(*self)->m_flush_scheduled = false;
+								}
+							}));
+						return;
+					}
+					else if (ec == boost::asio::error::no_buffer_space and not m_zerocopy_pending.empty()){
+						// retrying right away only spins, the completion of the zerocopy wait resumes the flush
+						m_flush_waits_zerocopy = true;
+						schedule_zerocopy_wait();
+						return;
+					}
+					else if (ec){
+						// the kernel refuse this very datagram, report and skip it
+						auto& [msg, length, dest, handler] = m_flushing[m_flushing_done++];
+						if (handler)
+							handler(ec, 0u);
+					}
+				}
+				// yield to other handlers(e.g. feedback reading) when there are too many to send
+				boost::asio::post(m_net_io_ctx, ya_uftp::detail::make_handler_with_memory(m_flush_handler_memory, 
+					[alive = std::weak_ptr<worker*>{m_alive_token}](){
+						if (auto self = alive.lock())
+							(*self)->do_flush_datagrams();
+					}));
+			}
+			
+#ifdef __linux__
+			std::pair<std::size_t, boost::system::error_code> worker::send_datagrams(){
+				struct alignas(::cmsghdr) gso_control{
+					char buf[CMSG_SPACE(sizeof(std::uint16_t))];
+				};
+				std::array<::mmsghdr, m_max_datagrams_per_syscall> msgs;
+				// the header and the attachment of a datagram are gathered from two places
+				std::array<::iovec, m_max_datagrams_per_syscall * 2> iovs;
+				std::array<gso_control, m_max_datagrams_per_syscall> controls;
+				std::array<std::size_t, m_max_datagrams_per_syscall> segments_count;
+				const auto count = m_flushing.size() - m_flushing_done;
+				auto msg_count = 0u;
+				auto iov_count = 0u;
+				auto zerocopy = false;
+#ifdef YA_UFTP_HAS_MSG_ZEROCOPY
+				// the notifications are not worth it for the small control messages
+				if (m_zerocopy_enabled){
+					for (auto i = m_flushing_done; i < m_flushing.size() and not zerocopy; i++)
+						zerocopy = std::get<0>(m_flushing[i])->attachment_size() > 0u;
+				}
+#endif
+				// the pinned pages become the fragments of the super datagram and a skb holds MAX_SKB_FRAGS(17) at most,
+				// every segment takes one for the header and up to two for a block crossing a page boundary
+				const auto max_segments = zerocopy ? m_max_zerocopy_gso_segments : m_max_gso_segments;
+				for (auto i = 0u; i < count;){
+					auto& [msg, length, dest, handler] = m_flushing[m_flushing_done + i];
+					auto segments = 1u;
+					auto total_length = length;
+					// consecutive datagrams of the same size to the same destination can be 
+					// handed over as one super datagram, the kernel(or NIC) segments it on the way out.
+					// only the last segment is allowed to be shorter.
+					if (m_gso_enabled){
+						while (i + segments < count and segments < max_segments){
+							auto& [next_msg, next_length, next_dest, next_handler] = m_flushing[m_flushing_done + i + segments];
+							if (next_length > length or 
+								total_length + next_length > m_max_gso_bytes or
+								next_dest != dest)
+								break;
+							total_length += next_length;
+							segments++;
+							if (next_length < length)
+								break;
+						}
+					}
+					const auto first_iov = iov_count;
+					for (auto j = i; j < i + segments; j++){
+						auto& [seg_msg, seg_length, seg_dest, seg_handler] = m_flushing[m_flushing_done + j];
+						const auto attachment_size = seg_msg->attachment_size();
+						iovs[iov_count].iov_base = seg_msg->data();
+						iovs[iov_count++].iov_len = seg_length - attachment_size;
+						if (attachment_size > 0u){
+							iovs[iov_count].iov_base = const_cast<std::uint8_t*>(seg_msg->attachment());
+							iovs[iov_count++].iov_len = attachment_size;
+						}
+					}
+					msgs[msg_count] = ::mmsghdr{};
+					msgs[msg_count].msg_hdr.msg_name = const_cast<boost::asio::ip::udp::endpoint&>(dest).data();
+					msgs[msg_count].msg_hdr.msg_namelen = dest.size();
+					msgs[msg_count].msg_hdr.msg_iov = &iovs[first_iov];
+					msgs[msg_count].msg_hdr.msg_iovlen = iov_count - first_iov;
+					if (segments > 1){
+						msgs[msg_count].msg_hdr.msg_control = controls[msg_count].buf;
+						msgs[msg_count].msg_hdr.msg_controllen = sizeof(controls[msg_count].buf);
+						auto cm = CMSG_FIRSTHDR(&msgs[msg_count].msg_hdr);
+						cm->cmsg_level = SOL_UDP;
+						cm->cmsg_type = UDP_SEGMENT;
+						cm->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+						auto segment_size = static_cast<std::uint16_t>(length);
+						std::memcpy(CMSG_DATA(cm), &segment_size, sizeof(segment_size));
+					}
+					segments_count[msg_count++] = segments;
+					i += segments;
+				}
+				auto result = 0;
+				do {
+#ifdef YA_UFTP_HAS_MSG_ZEROCOPY
+					result = ::sendmmsg(m_socket.native_handle(), msgs.data(), msg_count, zerocopy ? MSG_ZEROCOPY : 0);
+#else
+					result = ::sendmmsg(m_socket.native_handle(), msgs.data(), msg_count, 0);
+#endif
+				} while (result < 0 and errno == EINTR);
+				m_send_syscalls.fetch_add(1u, std::memory_order_relaxed);
+				if (result < 0){
+					auto err = errno;
+					if (segments_count[0] > 1 and 
+						(err == EIO or err == EINVAL or err == ENOPROTOOPT or err == EOPNOTSUPP)){
+						// the kernel, the route or the NIC refuse segmentation offload,
+						// fallback to plain datagrams, nothing has been sent yet.
+						m_gso_enabled = false;
+						return {0u, boost::system::error_code{}};
+					}
+#ifdef YA_UFTP_HAS_MSG_ZEROCOPY
+					if (zerocopy and err == ENOBUFS){
+						// too many pages pinned by the unreleased sends, the flush waits for their release
+						reap_zerocopy_completions();
+						if (not m_zerocopy_pending.empty())
+							return {0u, boost::asio::error::no_buffer_space};
+						m_zerocopy_enabled = false;
+						return {0u, boost::system::error_code{}};
+					}
+					if (zerocopy and err == EMSGSIZE){
+						// the kernel is built with less fragments per skb, let it copy instead
+						m_zerocopy_enabled = false;
+						return {0u, boost::system::error_code{}};
+					}
+#endif
+					return {0u, boost::system::error_code{err, boost::asio::error::get_system_category()}};
+				}
+				auto datagrams_sent = std::size_t(0u);
+				for (auto i = 0; i < result; i++){
+#ifdef YA_UFTP_HAS_MSG_ZEROCOPY
+					// the pages of the send must stay untouched until the kernel releases its id
+					if (zerocopy){
+						const auto id = m_zerocopy_next_id++;
+						for (auto j = datagrams_sent; j < datagrams_sent + segments_count[i]; j++)
+							m_zerocopy_pending.emplace(id, std::get<0>(m_flushing[m_flushing_done + j]));
+					}
+#endif
+					datagrams_sent += segments_count[i];
+				}
+				m_datagrams_sent.fetch_add(datagrams_sent, std::memory_order_relaxed);
+				if (not m_zerocopy_pending.empty())
+					schedule_zerocopy_wait();
+				return {datagrams_sent, boost::system::error_code{}};
+			}
+			
+			void worker::reap_zerocopy_completions(){
+#ifdef YA_UFTP_HAS_MSG_ZEROCOPY
+				struct alignas(::cmsghdr) error_control{
+					char buf[CMSG_SPACE(sizeof(::sock_extended_err) + sizeof(::sockaddr_in6))];
+				};
+				while (not m_zerocopy_pending.empty()){
+					auto control = error_control{};
+					auto hdr = ::msghdr{};
+					hdr.msg_control = control.buf;
+					hdr.msg_controllen = sizeof(control.buf);
+					auto result = 0;
+					do {
+						result = ::recvmsg(m_socket.native_handle(), &hdr, MSG_ERRQUEUE | MSG_DONTWAIT);
+					} while (result < 0 and errno == EINTR);
+					if (result < 0)
+						break;
+					for (auto cm = CMSG_FIRSTHDR(&hdr); cm; cm = CMSG_NXTHDR(&hdr, cm)){
+						if (not (cm->cmsg_level == SOL_IP and cm->cmsg_type == IP_RECVERR) and
+							not (cm->cmsg_level == SOL_IPV6 and cm->cmsg_type == IPV6_RECVERR))
+							continue;
+						auto ee = ::sock_extended_err{};
+						std::memcpy(&ee, CMSG_DATA(cm), sizeof(ee));
+						if (ee.ee_errno != 0 or ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+							continue;
+						// ee_info to ee_data inclusively, the ids wrap around
+						const auto released = std::uint64_t(ee.ee_data - ee.ee_info) + 1u;
+						if (ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED){
+							// the device can not send from user pages, pinning them is pure overhead
+							m_zerocopy_copied.fetch_add(released, std::memory_order_relaxed);
+							m_zerocopy_enabled = false;
+						}
+						else
+							m_zerocopy_sends.fetch_add(released, std::memory_order_relaxed);
+						release_zerocopy_range(ee.ee_info, ee.ee_data);
+					}
+				}
+#endif
+			}
+			
+			void worker::release_zerocopy_range(std::uint32_t first, std::uint32_t last){
+				auto in_range = [](std::uint32_t id, std::uint32_t first, std::uint32_t last){
+					return static_cast<std::uint32_t>(id - first) <= static_cast<std::uint32_t>(last - first);
+				};
+				if (m_zerocopy_pending.empty() or m_zerocopy_pending.front().first != first){
+					m_zerocopy_released_ahead.emplace_back(first, last);
+					return;
+				}
+				while (true){
+					while (not m_zerocopy_pending.empty() and in_range(m_zerocopy_pending.front().first, first, last))
+						m_zerocopy_pending.pop();
+					if (m_zerocopy_pending.empty())
+						break;
+					// the oldest pending send may have been released earlier
+					auto ahead = std::find_if(m_zerocopy_released_ahead.begin(), m_zerocopy_released_ahead.end(), 
+						[id = m_zerocopy_pending.front().first](auto& range){ return range.first == id; });
+					if (ahead == m_zerocopy_released_ahead.end())
+						break;
+					std::tie(first, last) = *ahead;
+					m_zerocopy_released_ahead.erase(ahead);
+				}
+			}
+			
+			void worker::schedule_zerocopy_wait(){
+				if (m_zerocopy_wait_scheduled)
+					return;
+				m_zerocopy_wait_scheduled = true;
+				// the notifications are queued on the socket error queue, which raises the error condition
+				m_socket.async_wait(boost::asio::ip::udp::socket::wait_error, 
+					[alive = std::weak_ptr<worker*>{m_alive_token}](const boost::system::error_code ec){
+						auto self = alive.lock();
+						if (not self)
+							return;
+						(*self)->m_zerocopy_wait_scheduled = false;
+						(*self)->reap_zerocopy_completions();
+						if (not ec and not (*self)->m_zerocopy_pending.empty())
+							(*self)->schedule_zerocopy_wait();
+						if ((*self)->m_flush_waits_zerocopy){
+							(*self)->m_flush_waits_zerocopy = false;
+							if (not ec)
+								(*self)->do_flush_datagrams();
+							else{
+								// the unsent datagrams stay queued, the next send will reschedule the flush
+								std::lock_guard queue_lock((*self)->m_queue_mutex);
+								(*self)->m_flush_scheduled = false;
+							}
+						}
+					});
+			}
+#else
+			std::pair<std::size_t, boost::system::error_code> worker::send_datagrams(){
+				// no batching syscall available, fall back to one datagram per syscall
+				auto sent_count = 0u;
+				auto ec = boost::system::error_code{};
+				for (auto i = m_flushing_done; i < m_flushing.size(); i++){
+					auto& [msg, length, dest, handler] = m_flushing[i];
+					const auto attachment_size = msg->attachment_size();
+					auto buffers = std::array<boost::asio::const_buffer, 2>{
+						boost::asio::buffer(msg->data(), length - attachment_size),
+						boost::asio::buffer(msg->attachment(), attachment_size)};
+					m_socket.send_to(buffers, dest, 0, ec);
+					m_send_syscalls.fetch_add(1u, std::memory_order_relaxed);
+					if (ec)
+						break;
+					sent_count++;
+				}
+				m_datagrams_sent.fetch_add(sent_count, std::memory_order_relaxed);
+				return {sent_count, ec};
+			}
+			
+			void worker::reap_zerocopy_completions(){}
+			
+			void worker::release_zerocopy_range(std::uint32_t first, std::uint32_t last){}
+			
+			void worker::schedule_zerocopy_wait(){}
+#endif
 		}
 	}
 }
\ No newline at end of file
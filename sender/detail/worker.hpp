@@ -6,8 +6,12 @@
 #include <random>
 #include <queue>
 #include <list>
+#include <mutex>
+#include <atomic>
 #include "sender/detail/session_context.hpp"
 #include "detail/common.hpp"
+#include "detail/ring_queue.hpp"
+#include "detail/handler_memory.hpp"
 
 namespace ya_uftp{
 	namespace sender{
@@ -20,10 +24,51 @@ namespace ya_uftp{
 						virtual void on_message_received(message::validated_packet valid_packet) = 0; 
 						virtual ~employer();
 					};
-					using rw_handler = std::function<void(const boost::system::error_code, std::size_t)>;
+					// one long living object completes every packet of a task, so no closure is created per packet
+					class send_completion {
+					public:
+						virtual void on_packet_sent(const boost::system::error_code ec, std::size_t bytes_sent) = 0;
+						virtual ~send_completion();
+					};
+					// either a send_completion shared by many packets, or a one-off closure for the rare messages
+					class rw_handler {
+						std::shared_ptr<send_completion>	m_completion;
+						std::function<void(const boost::system::error_code, std::size_t)>	m_closure;
+					public:
+						rw_handler() = default;
+						rw_handler(std::nullptr_t){}
+						rw_handler(std::shared_ptr<send_completion> completion) : m_completion(std::move(completion)){}
+						template<typename F, typename = std::enable_if_t<
+							not std::is_same_v<std::decay_t<F>, rw_handler> and
+							std::is_invocable_v<F&, const boost::system::error_code, std::size_t>>>
+						rw_handler(F&& f) : m_closure(std::forward<F>(f)){}
+						
+						explicit operator bool() const{
+							return m_completion or m_closure;
+						}
+						void operator()(const boost::system::error_code ec, std::size_t bytes_sent) const{
+							if (m_completion)
+								m_completion->on_packet_sent(ec, bytes_sent);
+							else if (m_closure)
+								m_closure(ec, bytes_sent);
+						}
+					};
+					using body_writer = function_ref<std::size_t (api::blob_span)>;
 					using send_args = std::tuple<message_blob, std::size_t, 
 						const boost::asio::ip::udp::endpoint&, rw_handler>;
 				private:
+					using queued_send = std::pair<send_args, std::chrono::steady_clock::time_point>;
+					// updated by the producers and the net thread, read by statistics() from anywhere
+					struct lane_counters{
+						std::atomic<std::uint64_t>	depth = 0u;
+						std::atomic<std::uint64_t>	datagrams = 0u;
+						std::atomic<std::uint64_t>	total_wait_us = 0u;
+						std::atomic<std::uint64_t>	max_wait_us = 0u;
+						
+						void on_dequeued(std::chrono::steady_clock::time_point queued_at, std::chrono::steady_clock::time_point now);
+						task::queue_statistics snapshot() const;
+					};
+
 					boost::asio::io_context&		m_net_io_ctx;
 					boost::asio::io_context&		m_file_io_ctx;
 					boost::asio::ip::udp::socket	m_socket;
@@ -33,17 +78,63 @@ namespace ya_uftp{
 					static std::uniform_int_distribution<std::uint32_t>		
 						m_rd_number_dist;
 					session_context					m_session_context;
+					ya_uftp::detail::packet_pool	m_packet_pool;
 					
-					static constexpr std::size_t	m_rc_send_per_second = 20u;
 					const std::uint32_t				m_bucket_full_size;
 					std::uint32_t					m_queued_packets_total_length = 0u;
-					std::uint64_t					m_rc_per_round_bytes_count;
+					// the pacer releases the queued datagrams as the credit earned at the transfer speed allows
+					const std::int64_t				m_pacing_burst_size;
+					std::int64_t					m_pacing_credit = 0;
+					std::chrono::steady_clock::time_point	m_pacing_last_refill = std::chrono::steady_clock::now();
+					// at high speeds the burst is what this much time earns, the timer would not keep up with smaller ones
+					static constexpr std::chrono::microseconds	m_pacing_burst_time = std::chrono::microseconds(250);
 					
 					using blocked_packets_params = std::tuple<
 						std::shared_ptr<std::vector<send_args>>, std::size_t, std::size_t, rw_handler>;
 					api::optional<blocked_packets_params> 	m_blocked_packets_params;
 					
-					std::queue<send_args>			m_sendout_queue;
+					// shared with the producers, guarded by m_queue_mutex
+					alignas(ya_uftp::detail::cache_line_size) std::mutex	m_queue_mutex;
+					ya_uftp::detail::ring_queue<queued_send>	m_sendout_queue;
+					// datagrams ready to be handed to the kernel, drained in batches by do_flush_datagrams()
+					ya_uftp::detail::ring_queue<queued_send>	m_flush_queue;
+					// every role but FILE_SEG and FILE_PARITY, flushed ahead of the data and never held back by the pacer
+					ya_uftp::detail::ring_queue<queued_send>	m_control_queue;
+					bool							m_flush_scheduled = false;
+					// a data datagram has been refused since the queue was full
+					bool							m_data_refused = false;
+					alignas(ya_uftp::detail::cache_line_size) lane_counters	m_control_lane;
+					alignas(ya_uftp::detail::cache_line_size) lane_counters	m_data_lane;
+					// the batch currently being pushed to the kernel, only touched in the net thread
+					alignas(ya_uftp::detail::cache_line_size) std::vector<send_args>	m_flushing;
+					std::size_t						m_flushing_done = 0u;
+					static constexpr std::size_t	m_max_datagrams_per_syscall = 64u;
+					static constexpr std::size_t	m_max_syscalls_per_flush = 16u;
+					// UDP_MAX_SEGMENTS of the kernel, and keep the super datagram within the 64K IP limit
+					static constexpr std::size_t	m_max_gso_segments = 64u;
+					static constexpr std::size_t	m_max_gso_bytes = 65000u;
+					static constexpr std::size_t	m_max_zerocopy_gso_segments = 5u;
+					bool							m_gso_enabled = false;
+					// SO_ZEROCOPY accepted by the socket, and no send has been copied by the kernel so far
+					bool							m_zerocopy_enabled = false;
+					// the kernel numbers every MSG_ZEROCOPY send, the datagrams of a send are held until it is released
+					std::uint32_t					m_zerocopy_next_id = 0u;
+					ya_uftp::detail::ring_queue<std::pair<std::uint32_t, message_blob>>	m_zerocopy_pending;
+					// released ranges which arrived ahead of an older pending send
+					std::vector<std::pair<std::uint32_t, std::uint32_t>>	m_zerocopy_released_ahead;
+					bool							m_zerocopy_wait_scheduled = false;
+					// the kernel ran out of pages to pin, the flush resumes once some sends are released
+					bool							m_flush_waits_zerocopy = false;
+					std::atomic<std::uint64_t>		m_zerocopy_sends = 0u;
+					std::atomic<std::uint64_t>		m_zerocopy_copied = 0u;
+					// handlers queued by the worker itself may outlive it, they check this token before touching the worker
+					std::shared_ptr<worker*>		m_alive_token;
+					// at most one flush handler is queued at any time, it always reuses this memory
+					std::shared_ptr<ya_uftp::detail::handler_memory>	m_flush_handler_memory;
+					std::atomic<std::uint64_t>		m_datagrams_sent = 0u;
+					std::atomic<std::uint64_t>		m_send_syscalls = 0u;
+					// (grtt in microseconds << 8) | quantized grtt, so the quantization only runs when grtt changes
+					std::atomic<std::uint64_t>		m_quantized_grtt_cache = std::numeric_limits<std::uint64_t>::max();
 					std::weak_ptr<employer>			m_employer;
 					std::list<std::weak_ptr<boost::asio::steady_timer>>
 													m_job_timers;
@@ -55,12 +146,25 @@ namespace ya_uftp{
 						write_receivers_id(api::blob_span buffer, 
 						std::map<std::uint32_t, session_context::receiver_properties>& receivers_states,
 						std::map<std::uint32_t, session_context::receiver_properties>::iterator start,
-						std::function<bool (session_context::receiver_properties&)> filter);
+						function_ref<bool (session_context::receiver_properties&)> filter);
 					bool try_init_server_id_from_addr(const boost::asio::ip::address& uni_addr, const task::parameters& params);
 					
-					static std::size_t do_complete_message(message_blob msg, std::function<std::size_t (api::blob_span)> write_body);
+					static std::size_t do_complete_message(const message_blob& msg, body_writer write_body);
 					std::pair<bool, std::size_t> send_multiple_packets(std::shared_ptr<std::vector<send_args>> packets,
 						rw_handler result_handler = nullptr, std::size_t begin_idx = 0u);
+					
+					// must be called with m_queue_mutex held, return true if the caller should do the flush itself
+					bool schedule_flush(bool in_net_thread);
+					void do_flush_datagrams();
+					// try to hand m_flushing[m_flushing_done, m_flushing.size()) to the kernel with as few syscalls as possible,
+					// return the count of datagrams accepted by the kernel
+					std::pair<std::size_t, boost::system::error_code> send_datagrams();
+					// read the completion notifications from the error queue and drop the released datagrams
+					void reap_zerocopy_completions();
+					void release_zerocopy_range(std::uint32_t first, std::uint32_t last);
+					void schedule_zerocopy_wait();
+					// resume the blocked packets, then let the employer queue more
+					void notify_bucket_freed();
 				public:
 					
 					worker(boost::asio::io_context& net_io_ctx, 
@@ -72,11 +176,14 @@ namespace ya_uftp{
 					worker& operator=(worker&&) = delete;
 					~worker();
 					void setup_header(message::protocol_header& uftp_hdr, message::role r);
+					// everything but the sequence number, which is stamped per message
+					void setup_header_template(message::protocol_header& uftp_hdr, message::role r);
+					std::uint8_t quantized_grtt();
 					[[nodiscard]] 
 					std::pair<bool, std::size_t> 
 						send_packet(message_blob packet, 
 						const boost::asio::ip::udp::endpoint& dest,
-						std::function<std::size_t (api::blob_span)> write_body = nullptr, 
+						body_writer write_body = nullptr, 
 						api::optional<std::size_t> known_length = api::nullopt,
 						rw_handler result_handler = nullptr) ;
 						
@@ -98,6 +205,8 @@ namespace ya_uftp{
 					
 					void refine_grtt(std::function<bool(session_context::receiver_properties::status )> filter);
 					session_context& get_context() ;
+					ya_uftp::detail::packet_pool& packet_pool();
+					task::statistics statistics() const;
 			};
 		}
 	}